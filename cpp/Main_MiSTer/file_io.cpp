@@ -74,6 +74,10 @@ fileTYPE::fileTYPE()
 	zip = 0;
 	size = 0;
 	offset = 0;
+	ra_buf = 0;
+	ra_size = 0;
+	ra_len = 0;
+	ra_start = 0;
 }
 
 fileTYPE::~fileTYPE()
@@ -293,10 +297,10 @@ void FileClose(fileTYPE *file)
 //		delete file->zip;
 //	}
 
-//	if (file->filp)
-//	{
-//		//printf("closing %p\n", file->filp);
-//		fclose(file->filp);
+	if (file->filp)
+	{
+		//printf("closing %p\n", file->filp);
+		fclose(file->filp);
 //		if (file->type == 1)
 //		{
 //			if (file->name[0] == '/')
@@ -305,7 +309,12 @@ void FileClose(fileTYPE *file)
 //			}
 //			file->type = 0;
 //		}
-//	}
+	}
+
+	if (file->ra_buf) free(file->ra_buf);
+	file->ra_buf = nullptr;
+	file->ra_size = 0;
+	file->ra_len = 0;
 
 	file->zip = nullptr;
 	file->filp = nullptr;
@@ -547,7 +556,19 @@ int FileOpen(fileTYPE *file, const char *name, char mute)
 
 int FileSeek(fileTYPE *file, __off64_t offset, int origin)
 {
-	if (file->filp)
+	if (file->filp && file->ra_buf)
+	{
+		// positional mode: the FILE position is not used, nothing to flush
+		if (origin == SEEK_CUR) offset += file->offset;
+		else if (origin == SEEK_END) offset += file->size;
+
+		if (offset < 0)
+		{
+			printf("Fail to seek the file: offset=%lld, %s.\n", offset, file->name);
+			return 0;
+		}
+	}
+	else if (file->filp)
 	{
 		__off64_t res = fseeko64(file->filp, offset, origin);
 		if (res < 0)
@@ -620,7 +641,12 @@ int FileReadAdv(fileTYPE *file, void *pBuffer, int length, int failres)
 {
 	ssize_t ret = 0;
 
-	if (file->filp)
+	if (file->filp && file->ra_buf)
+	{
+		ret = FileReadAt(file, file->offset, pBuffer, length);
+		if (ret < 0) return failres;
+	}
+	else if (file->filp)
 	{
 		ret = fread(pBuffer, 1, length, file->filp);
 		if (ret < 0)
@@ -657,6 +683,125 @@ int FileReadSec(fileTYPE *file, void *pBuffer)
 	return FileReadAdv(file, pBuffer, 512);
 }
 
+static int ra_fill(fileTYPE *file, __off64_t offset)
+{
+	int fd = fileno(file->filp);
+	__off64_t start = offset & ~(__off64_t)(file->ra_size - 1);
+
+	ssize_t ret = pread64(fd, file->ra_buf, file->ra_size, start);
+	if (ret < 0)
+	{
+		printf("FileReadAt(pread) File:%s, error: %s.\n", file->name, strerror(errno));
+		file->ra_len = 0;
+		return 0;
+	}
+
+	file->ra_start = start;
+	file->ra_len = ret;
+
+	// streams mostly run on, let the card start on the next window
+	if (ret == file->ra_size) posix_fadvise64(fd, start + ret, file->ra_size, POSIX_FADV_WILLNEED);
+	return 1;
+}
+
+int FileReadAt(fileTYPE *file, __off64_t offset, void *pBuffer, int length)
+{
+	if (!file->filp)
+	{
+		printf("FileReadAt error(unknown file type).\n");
+		return -1;
+	}
+
+	if (!file->ra_buf)
+	{
+		ssize_t ret = pread64(fileno(file->filp), pBuffer, length, offset);
+		if (ret < 0) printf("FileReadAt(pread) File:%s, error: %s.\n", file->name, strerror(errno));
+		return ret;
+	}
+
+	uint8_t *p = (uint8_t*)pBuffer;
+	int total = 0;
+	while (total < length)
+	{
+		__off64_t pos = offset + total;
+		if (pos < file->ra_start || pos >= file->ra_start + file->ra_len)
+		{
+			// large aligned requests skip the window altogether
+			int left = length - total;
+			if (left >= file->ra_size && !(pos & (file->ra_size - 1)))
+			{
+				left &= ~(file->ra_size - 1);
+				ssize_t ret = pread64(fileno(file->filp), p + total, left, pos);
+				if (ret < 0)
+				{
+					printf("FileReadAt(pread) File:%s, error: %s.\n", file->name, strerror(errno));
+					return total ? total : -1;
+				}
+				total += ret;
+				if (ret < left) break;
+				continue;
+			}
+
+			if (!ra_fill(file, pos)) return total ? total : -1;
+			if (pos >= file->ra_start + file->ra_len) break; // EOF
+		}
+
+		int skip = pos - file->ra_start;
+		int len = MIN(file->ra_len - skip, length - total);
+		memcpy(p + total, file->ra_buf + skip, len);
+		total += len;
+	}
+
+	return total;
+}
+
+int FileSetReadahead(fileTYPE *file, int size)
+{
+	if (!file->filp) return 0;
+
+	int fd = fileno(file->filp);
+	if (size <= 0)
+	{
+		if (file->ra_buf)
+		{
+			// hand the position back to stdio
+			free(file->ra_buf);
+			file->ra_buf = nullptr;
+			file->ra_size = 0;
+			file->ra_len = 0;
+			fseeko64(file->filp, file->offset, SEEK_SET);
+		}
+		posix_fadvise64(fd, 0, 0, POSIX_FADV_NORMAL);
+		return 1;
+	}
+
+	if (size > FILE_READAHEAD_MAX)
+	{
+		printf("FileSetReadahead File:%s, size %d clamped to %d.\n", file->name, size, FILE_READAHEAD_MAX);
+		size = FILE_READAHEAD_MAX;
+	}
+
+	int align = 4096;
+	while (align < size) align <<= 1;
+
+	uint8_t *buf = (uint8_t*)aligned_alloc(4096, align);
+	if (!buf)
+	{
+		printf("FileSetReadahead(alloc) File:%s, size: %d.\n", file->name, align);
+		return 0;
+	}
+
+	if (file->ra_buf) free(file->ra_buf);
+	file->ra_buf = buf;
+	file->ra_size = align;
+	file->ra_len = 0;
+	file->ra_start = 0;
+
+	// the window does the readahead, kernel readahead would only fetch past a seek
+	posix_fadvise64(fd, 0, 0, POSIX_FADV_RANDOM);
+	return 1;
+}
+
 // Write with offset advancing
 /*
 int FileWriteAdv(fileTYPE *file, void *pBuffer, int length, int failres)
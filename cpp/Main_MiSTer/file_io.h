@@ -24,6 +24,12 @@ struct fileTYPE
 	__off64_t       offset;
 	char            path[1024];
 	char            name[261];
+
+	// readahead window, see FileSetReadahead
+	uint8_t        *ra_buf;
+	int             ra_size;
+	int             ra_len;
+	__off64_t       ra_start;
 };
 
 struct direntext_t
@@ -57,11 +63,20 @@ int FileSeekLBA(fileTYPE *file, uint32_t offset);
 
 int FileReadAdv(fileTYPE *file, void *pBuffer, int length, int failres = 0);
 int FileReadSec(fileTYPE *file, void *pBuffer);
+
+// Positional read, leaves the file offset alone. Served from the readahead window when one is set.
+int FileReadAt(fileTYPE *file, __off64_t offset, void *pBuffer, int length);
+
+// size > 0: reads go through pread in aligned windows of size bytes (power of two, 4K minimum,
+// FILE_READAHEAD_MAX at most) and the kernel is told the access is random. size = 0 returns to plain stdio.
+#define FILE_READAHEAD_MAX (64 << 20)
+int FileSetReadahead(fileTYPE *file, int size);
 //int FileWriteAdv(fileTYPE *file, void *pBuffer, int length, int failres = 0);
 //int FileWriteSec(fileTYPE *file, void *pBuffer);
 //int FileCreatePath(const char *dir);
 
 int FileExists(const char *name, int use_zip = 1);
+int FileLoad(const char *name, void *pBuffer, int size); // supply pBuffer = 0 to get the file size without loading
 //int FileCanWrite(const char *name);
 //int PathIsDir(const char *name, int use_zip = 1);
 //struct stat64* getPathStat(const char *path);
@@ -78,7 +93,6 @@ void FileGenerateSavestatePath(const char *name, char* out_name, int sufx);
 void FileGenerateScreenshotName(const char *name, char *out_name, int buflen);
 
 int FileSave(const char *name, void *pBuffer, int size);
-int FileLoad(const char *name, void *pBuffer, int size); // supply pBuffer = 0 to get the file size without loading
 int FileDelete(const char *name);
 int DirDelete(const char *name);
 
@@ -11,6 +11,7 @@
 
 #include "fpga_io.h"
 #include "file_io.h"
+#include "spi.h"
 //#include "input.h"
 //#include "osd.h"
 //#include "menu.h"
@@ -547,10 +548,11 @@ static int fpgamgr_poll_fpga_ready(void)
 //	return coretype & 0xFF;
 //}
 //
-//int fpga_get_fio_size()
-//{
+int fpga_get_fio_size()
+{
 //	return (fpga_gpi_read() >> 16) & 1;
-//}
+	return spi_bus_wide();
+}
 //
 //int fpga_get_io_version()
 //{
@@ -666,6 +668,7 @@ static int fpgamgr_poll_fpga_ready(void)
 
 uint16_t fpga_spi(uint16_t word)
 {
+	return spi_bus_word(word);
 //	uint32_t gpo = (fpga_gpo_read() & ~(0xFFFF | SSPI_STROBE)) | word;
 //
 //	fpga_gpo_write(gpo);
@@ -701,6 +704,7 @@ uint16_t fpga_spi(uint16_t word)
 
 uint16_t fpga_spi_fast(uint16_t word)
 {
+	return spi_bus_word(word, 1);
 //	uint32_t gpo = (fpga_gpo_read() & ~(0xFFFF | SSPI_STROBE)) | word;
 //	fpga_gpo_write(gpo);
 //	fpga_gpo_write(gpo | SSPI_STROBE);
@@ -710,6 +714,7 @@ uint16_t fpga_spi_fast(uint16_t word)
 
 void fpga_spi_fast_block_write(const uint16_t *buf, uint32_t length)
 {
+	spi_bus_block_write(buf, length, SPI_BUS_16);
 //	uint32_t gpoH = (fpga_gpo_read() & ~(0xFFFF | SSPI_STROBE));
 //	uint32_t gpo = gpoH;
 //
@@ -725,6 +730,7 @@ void fpga_spi_fast_block_write(const uint16_t *buf, uint32_t length)
 
 void fpga_spi_fast_block_read(uint16_t *buf, uint32_t length)
 {
+	spi_bus_block_read(buf, length, SPI_BUS_16);
 //	uint32_t gpo = (fpga_gpo_read() & ~(0xFFFF | SSPI_STROBE));
 //	uint32_t rem = length % 16;
 //	length /= 16;
@@ -808,6 +814,7 @@ void fpga_spi_fast_block_read(uint16_t *buf, uint32_t length)
 
 void fpga_spi_fast_block_write_8(const uint8_t *buf, uint32_t length)
 {
+	spi_bus_block_write(buf, length, SPI_BUS_8);
 //	uint32_t gpoH = (fpga_gpo_read() & ~(0xFFFF | SSPI_STROBE));
 //	uint32_t gpo = gpoH;
 //	uint32_t rem = length % 16;
@@ -894,6 +901,7 @@ void fpga_spi_fast_block_write_8(const uint8_t *buf, uint32_t length)
 
 void fpga_spi_fast_block_read_8(uint8_t *buf, uint32_t length)
 {
+	spi_bus_block_read(buf, length, SPI_BUS_8);
 //	uint32_t gpo = (fpga_gpo_read() & ~(0xFFFF | SSPI_STROBE));
 //	uint32_t rem = length % 16;
 //	length /= 16;
@@ -977,6 +985,7 @@ void fpga_spi_fast_block_read_8(uint8_t *buf, uint32_t length)
 
 void fpga_spi_fast_block_write_be(const uint16_t *buf, uint32_t length)
 {
+	spi_bus_block_write(buf, length, SPI_BUS_16BE);
 //	uint32_t gpoH = (fpga_gpo_read() & ~(0xFFFF | SSPI_STROBE));
 //	uint32_t gpo = gpoH;
 //
@@ -994,6 +1003,7 @@ void fpga_spi_fast_block_write_be(const uint16_t *buf, uint32_t length)
 
 void fpga_spi_fast_block_read_be(uint16_t *buf, uint32_t length)
 {
+	spi_bus_block_read(buf, length, SPI_BUS_16BE);
 //	uint32_t gpo = (fpga_gpo_read() & ~(0xFFFF | SSPI_STROBE));
 //
 //	// should be optimized for speed by compiler automatically
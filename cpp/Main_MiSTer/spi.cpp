@@ -1,5 +1,6 @@
 #include "../../verilator/common.h"
 #include "spi.h"
+#include <stdio.h>
 //#include "hardware.h"
 //#include "fpga_io.h"
 
@@ -9,15 +10,120 @@
 
 //#define SWAPW(a) ((((a)<<8)&0xff00)|(((a)>>8)&0x00ff))
 
+/* Cycle-level model of the HPS bus, as the core sees it on EXT_BUS_IN:
+ * [31:16] io_din, [33] io_strobe, [34] io_enable, [35] fp_enable.
+ * Every word is held with io_strobe high for exactly one clk_sys cycle, followed by
+ * idle cycles that stand in for the gpo/gpi handshake on the real board. */
+#define BUS_DIN     (0xFFFFULL << 16)
+#define BUS_STROBE  (1ULL << 33)
+#define BUS_IO_EN   (1ULL << 34)
+#define BUS_FPGA_EN (1ULL << 35)
+
+static void (*bus_tick)(void) = 0;
+static int bus_wide = 0;
+static int bus_word_gap = 3;   // fpga_spi(): strobe, wait ack, release, wait ack
+static int bus_block_gap = 1;  // fast block transfers: strobe, release
+static int bus_busy = 0;
+
+void spi_bus_init(void (*tick)(void), int wide, int word_gap, int block_gap)
+{
+	bus_tick = tick;
+	bus_wide = wide;
+	bus_word_gap = word_gap;
+	bus_block_gap = block_gap;
+}
+
+int spi_bus_busy()
+{
+	return bus_busy;
+}
+
+int spi_bus_wide()
+{
+	return bus_wide;
+}
+
+static inline void bus_cycle()
+{
+	if (bus_tick)
+	{
+		bus_busy++;
+		bus_tick();
+		bus_busy--;
+	}
+}
+
+uint16_t spi_bus_word(uint16_t word, int fast)
+{
+	int gap = fast ? bus_block_gap : bus_word_gap;
+	vluint64_t base = top->EXT_BUS_IN & ~(BUS_DIN | BUS_STROBE);
+
+	top->EXT_BUS_IN = base | ((vluint64_t)word << 16) | BUS_STROBE;
+	bus_cycle();
+	uint16_t res = (uint16_t)top->EXT_BUS_OUT;
+
+	top->EXT_BUS_IN = base | ((vluint64_t)word << 16);
+	while (gap--) bus_cycle();
+
+	return res;
+}
+
+void spi_bus_block_write(const void *buf, uint32_t length, int mode, int fast)
+{
+	int gap = fast ? bus_block_gap : bus_word_gap;
+	vluint64_t base = top->EXT_BUS_IN & ~(BUS_DIN | BUS_STROBE);
+	vluint64_t din = 0;
+
+	// with no gap io_strobe stays high and a new word goes out every cycle (burst)
+	for (uint32_t i = 0; i < length; i++)
+	{
+		switch (mode)
+		{
+		case SPI_BUS_8:    din = ((const uint8_t*)buf)[i]; break;
+		case SPI_BUS_16:   din = ((const uint16_t*)buf)[i]; break;
+		case SPI_BUS_16BE: din = (uint16_t)((((const uint16_t*)buf)[i] << 8) | (((const uint16_t*)buf)[i] >> 8)); break;
+		}
+
+		top->EXT_BUS_IN = base | (din << 16) | BUS_STROBE;
+		bus_cycle();
+
+		if (gap)
+		{
+			top->EXT_BUS_IN = base | (din << 16);
+			for (int n = 0; n < gap; n++) bus_cycle();
+		}
+	}
+
+	top->EXT_BUS_IN = base | (din << 16);
+}
+
+void spi_bus_block_read(void *buf, uint32_t length, int mode)
+{
+	for (uint32_t i = 0; i < length; i++)
+	{
+		uint16_t res = spi_bus_word(0, 1);
+		switch (mode)
+		{
+		case SPI_BUS_8:    ((uint8_t*)buf)[i] = (uint8_t)res; break;
+		case SPI_BUS_16:   ((uint16_t*)buf)[i] = res; break;
+		case SPI_BUS_16BE: ((uint16_t*)buf)[i] = (uint16_t)((res << 8) | (res >> 8)); break;
+		}
+	}
+}
+
 void EnableFpga()
 {
 //	fpga_spi_en(SSPI_FPGA_EN, 1);
-
+	// whatever the uio mock left on io_din must not look like a first word
+	top->EXT_BUS_IN = (top->EXT_BUS_IN & ~(BUS_DIN | BUS_STROBE)) | BUS_FPGA_EN;
+	bus_cycle();
 }
 
 void DisableFpga()
 {
 //	fpga_spi_en(SSPI_FPGA_EN, 0);
+	top->EXT_BUS_IN &= ~(BUS_FPGA_EN | BUS_STROBE);
+	bus_cycle();
 }
 
 //static int osd_target = OSD_ALL;
@@ -52,13 +158,13 @@ void EnableIO()
         return;
     }
 
-    printf("Main_MiSTeR -  enable IO\n");
     io_enabled = 1;
 //	fpga_spi_en(SSPI_IO_EN, 1);
     // Mock the IO Enable bit, bit 34
     top->EXT_BUS |= 1UL << 34;
     top->EXT_BUS_IN |= 1UL << 34;
     top->EXT_BUS_OUT |= 1UL << 34;
+    bus_cycle();
 }
 
 void DisableIO()
@@ -66,13 +172,13 @@ void DisableIO()
     if (io_enabled == 0) {
         return;
     }
-    printf("Main_MiSTeR -  disable IO\n");
     io_enabled = 0;
 //	fpga_spi_en(SSPI_IO_EN, 0);
     // Mock disabling the IO Enable bit
     top->EXT_BUS &= ~(1UL << 34);
     top->EXT_BUS_IN &= ~(1UL << 34);
     top->EXT_BUS_OUT &= ~(1UL << 34);
+    bus_cycle();
 }
 
 uint32_t spi32_w(uint32_t parm)
@@ -126,45 +232,10 @@ void spi_uio_cmd32_cont(uint8_t cmd, uint32_t parm)
 }
 
 /* User_io related SPI functions */
-vluint64_t incoming_command_byte_count = 0;
-uint16_t last_command = 255;
-uint16_t last_command_data1 = 0;
-uint16_t last_command_data2 = 0;
-
-/**
- * @param cmd - command you want to send to the FPGA
- * @returns req - request result, 255 is "no request result"
- */
 uint16_t spi_uio_cmd_cont(uint16_t cmd)
 {
 	EnableIO();
-
-    if (top->EXT_BUS_OUT & (1ULL << 32)) {
-        incoming_command_byte_count++;
-
-        if (incoming_command_byte_count == 4) {
-            last_command = top->EXT_BUS_OUT;
-            printf("Main_MiSTer - command detected - byte 1 - %lu\n", top->EXT_BUS_OUT);
-        }
-        if (incoming_command_byte_count == 5) {
-            printf("Main_MiSTer - command detected - byte 2 - %lu\n", top->EXT_BUS_OUT);
-        }
-        if (incoming_command_byte_count == 6) {
-            printf("Main_MiSTer - command detected - byte 3 - %lu\n", top->EXT_BUS_OUT);
-            incoming_command_byte_count = 0;
-            return last_command;
-        }
-
-        return 255;
-    }
-
-    top->EXT_BUS_IN = cmd;
-    top->EXT_BUS_IN = top->EXT_BUS_IN << 16;
-    top->EXT_BUS_IN |= 1UL << 33;
-    top->EXT_BUS_IN |= 1UL << 34;
-
-    return 255;
-//	return spi_w(cmd);
+	return spi_w(cmd);
 }
 
 uint16_t spi_uio_cmd(uint16_t cmd)
@@ -222,42 +293,42 @@ void spi_n(uint8_t value, uint16_t cnt)
 
 void spi_read(uint8_t *addr, uint32_t len, int wide)
 {
-//	if (wide)
-//	{
-//		uint32_t len16 = len >> 1;
-//		uint16_t *a16 = (uint16_t*)addr;
-//		while (len16--) *a16++ = spi_w(0);
-//		if (len & 1) *((uint8_t*)a16) = spi_w(0);
-//	}
-//	else
-//	{
-//		while (len--) *addr++ = spi_b(0);
-//	}
+	if (wide)
+	{
+		uint32_t len16 = len >> 1;
+		uint16_t *a16 = (uint16_t*)addr;
+		while (len16--) *a16++ = spi_w(0);
+		if (len & 1) *((uint8_t*)a16) = spi_w(0);
+	}
+	else
+	{
+		while (len--) *addr++ = spi_b(0);
+	}
 }
 
 void spi_write(const uint8_t *addr, uint32_t len, int wide)
 {
-//	if (wide)
-//	{
-//		uint32_t len16 = len >> 1;
-//		uint16_t *a16 = (uint16_t*)addr;
-//		while (len16--) spi_w(*a16++);
-//		if(len & 1) spi_w(*((uint8_t*)a16));
-//	}
-//	else
-//	{
-//		while (len--) spi_b(*addr++);
-//	}
+	// same bus timing as a spi_w()/spi_b() per word, without going through them for every word
+	if (wide)
+	{
+		uint32_t len16 = len >> 1;
+		spi_bus_block_write(addr, len16, SPI_BUS_16, 0);
+		if (len & 1) spi_w(addr[len - 1]);
+	}
+	else
+	{
+		spi_bus_block_write(addr, len, SPI_BUS_8, 0);
+	}
 }
 
 void spi_block_read(uint8_t *addr, int wide, int sz)
 {
-//	if (wide) fpga_spi_fast_block_read((uint16_t*)addr, sz/2);
-//	else fpga_spi_fast_block_read_8(addr, sz);
+	if (wide) fpga_spi_fast_block_read((uint16_t*)addr, sz/2);
+	else fpga_spi_fast_block_read_8(addr, sz);
 }
 
 void spi_block_write(const uint8_t *addr, int wide, int sz)
 {
-//	if (wide) fpga_spi_fast_block_write((const uint16_t*)addr, sz/2);
-//	else fpga_spi_fast_block_write_8(addr, sz);
+	if (wide) fpga_spi_fast_block_write((const uint16_t*)addr, sz/2);
+	else fpga_spi_fast_block_write_8(addr, sz);
 }
@@ -8,6 +8,19 @@
 #define OSD_VGA  2
 #define OSD_ALL  (OSD_VGA|OSD_HDMI)
 
+/* simulation: cycle-level HPS bus model on top->EXT_BUS_IN
+ * tick advances the core by one clk_sys cycle, the gaps are idle cycles after each word */
+#define SPI_BUS_8    0
+#define SPI_BUS_16   1
+#define SPI_BUS_16BE 2
+
+void spi_bus_init(void (*tick)(void), int wide, int word_gap = 3, int block_gap = 1);
+int spi_bus_busy();
+int spi_bus_wide();
+uint16_t spi_bus_word(uint16_t word, int fast = 0);
+void spi_bus_block_write(const void *buf, uint32_t length, int mode, int fast = 1);
+void spi_bus_block_read(void *buf, uint32_t length, int mode);
+
 /* chip select functions */
 void EnableFpga();
 void DisableFpga();
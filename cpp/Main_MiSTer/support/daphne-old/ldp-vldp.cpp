@@ -3,6 +3,17 @@
 #include <string.h>
 #include <time.h>
 #include <set>
+#include <algorithm>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/sysinfo.h>
 #include "mpo_fileio.h"
 #include "mpo_mem.h"
 #include "numstr.h"
@@ -114,6 +125,9 @@ ldp_vldp::ldp_vldp()
 	m_mpeg_path = "";
 	m_cur_mpeg_filename = "";
 	m_file_index = 0; // # of mpeg files in our list
+	m_segmap_files = 0;
+	m_bFramefileCompiled = false;
+	m_bLastFileParsed = false;
 	//m_framefile = g_game->get_shortgamename() + m_framefile;	// create a sensible default framefile name
 	m_framefile = "lair.txt";
 	m_bFramefileSet = false;
@@ -564,7 +578,7 @@ bool ldp_vldp::skip_forward(uint16_t frames_to_skip, uint16_t target_frame)
 	// this is ok (and possible) because we don't support skipping across files
 
 	unsigned int uFPKS = g_vldp_info->uFpks;
-	unsigned int uDiscFPKS = 23.976; //= g_game->get_disc_fpks();
+	unsigned int uDiscFPKS = get_disc_fpks();
 
 	// We don't support skipping on mpegs that differ from the disc framerate
 	if (uDiscFPKS == uFPKS)
@@ -776,8 +790,7 @@ void ldp_vldp::test_helper(unsigned uIterations)
 	// We aren't calling think_delay because we want to have a lot of milliseconds pass quickly without actually waiting.
 
 	// make a certain # of milliseconds elapse ....
-	for (unsigned int u = 0; u < uIterations; u++)
-		pre_think();
+	advance_ms(uIterations);
 
 }
 
@@ -794,6 +807,10 @@ bool ldp_vldp::read_frame_conversions()
 	
 	framefile_path = m_framefile;
 
+	// if the framefile hasn't changed since it was last compiled, we're done
+	if (mpo_file_exists(framefile_path.c_str()) && load_compiled_framefile(framefile_path))
+		return true;
+
 	p_ioFileConvert = mpo_open(framefile_path.c_str(), MPO_OPEN_READONLY);
 	
 	// if the file was not found in the relative directory, try looking for it in the framefile directory
@@ -801,6 +818,8 @@ bool ldp_vldp::read_frame_conversions()
 	{
 		//framefile_path = g_homedir.get_framefile(framefile_path);	// add directory to front of path
 		framefile_path = "./lair.txt";	// add directory to front of path
+		if (load_compiled_framefile(framefile_path))
+			return true;
 		p_ioFileConvert = mpo_open(framefile_path.c_str(), MPO_OPEN_READONLY);
 	}
 	
@@ -831,6 +850,13 @@ bool ldp_vldp::read_frame_conversions()
 						sizeof(m_mpeginfo) / sizeof(struct fileframes),
 						err_msg))
 					{
+						// resolve the mpeg directory now so the compiled framefile doesn't depend on the working directory
+						char cwd[PATH_MAX];
+						if ((m_mpeg_path[0] != '/') && getcwd(cwd, sizeof(cwd)))
+							m_mpeg_path = string(cwd) + "/" + m_mpeg_path;
+
+						build_segment_map();
+						save_compiled_framefile(framefile_path);
 						printf("Framefile parse succeeded. Video/Audio directory is: ");
 						//printf(m_mpeg_path.c_str());
 						result = true;
@@ -864,12 +890,190 @@ bool ldp_vldp::read_frame_conversions()
 	return result;
 }
 
+// Compiled framefile
+// <framefile>.ffc holds the resolved mpeg directory and the segment table, along with the size and
+//  mtime of the framefile, every mpeg and its .dat index as they were when it was written.
+// While all of those still match, a game starts with one small read and a stat per file instead
+//  of parsing the framefile and opening every mpeg. Any change and the text framefile is parsed again.
+
+#define FFC_MAGIC	0x43464644	// "DFFC"
+#define FFC_VERSION	1
+
+struct ffc_header
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t count;	// segments, one ffc_entry each after the strings
+	uint32_t ff_path_len;	// absolute framefile path, follows the header
+	uint32_t mpeg_path_len;	// resolved mpeg directory, follows the framefile path
+	uint32_t reserved;
+	uint64_t ff_size;
+	uint64_t ff_mtime;
+};
+
+struct ffc_entry
+{
+	int32_t frame;
+	uint32_t name_len;	// file name, follows the entry
+	uint64_t size;
+	uint64_t mtime;
+	uint64_t dat_size;	// 0 if the file had not been parsed yet
+	uint64_t dat_mtime;
+};
+
+// the .dat index VLDP writes next to each mpeg
+static string ffc_dat_path(const string &mpeg_path)
+{
+	string path = mpeg_path;
+	path.replace(path.length() - 3, 3, "dat");
+	return path;
+}
+
+static bool ffc_stat(const string &path, uint64_t &size, uint64_t &mtime)
+{
+	struct stat st;
+	size = mtime = 0;
+	if (stat(path.c_str(), &st) != 0) return false;
+
+	size = st.st_size;
+	mtime = st.st_mtime;
+	return true;
+}
+
+bool ldp_vldp::load_compiled_framefile(const string &framefile_path)
+{
+	bool result = false;
+	uint64_t ff_size, ff_mtime;
+	char ff_abs[PATH_MAX];
+
+	if (!ffc_stat(framefile_path, ff_size, ff_mtime) || !realpath(framefile_path.c_str(), ff_abs))
+		return false;
+
+	mpo_io *io = mpo_open((framefile_path + ".ffc").c_str(), MPO_OPEN_READONLY);
+	if (!io)
+		return false;
+
+	size_t size = (size_t) io->size;
+	unsigned char *buf = MPO_MALLOC(size + 1);
+	MPO_BYTES_READ bytes_read = 0;
+
+	if (mpo_read(buf, size, &bytes_read, io) && (bytes_read == size) && (size >= sizeof(ffc_header)))
+	{
+		ffc_header hdr;
+		memcpy(&hdr, buf, sizeof(hdr));
+		size_t pos = sizeof(hdr);
+
+		if ((hdr.magic == FFC_MAGIC) && (hdr.version == FFC_VERSION) && (hdr.count > 0) && (hdr.count <= MAX_MPEG_FILES) &&
+			(hdr.ff_size == ff_size) && (hdr.ff_mtime == ff_mtime) &&
+			(pos + hdr.ff_path_len + hdr.mpeg_path_len <= size) &&
+			(string((const char *) buf + pos, hdr.ff_path_len) == ff_abs))
+		{
+			pos += hdr.ff_path_len;
+			string mpeg_path((const char *) buf + pos, hdr.mpeg_path_len);
+			pos += hdr.mpeg_path_len;
+
+			set<string> sChecked;	// files listed more than once only get checked once
+			result = true;
+			for (unsigned int i = 0; (i < hdr.count) && result; i++)
+			{
+				ffc_entry e;
+				if (pos + sizeof(e) > size) { result = false; break; }
+				memcpy(&e, buf + pos, sizeof(e));
+				pos += sizeof(e);
+
+				if ((pos + e.name_len > size) || (e.name_len < 4)) { result = false; break; }
+				string name((const char *) buf + pos, e.name_len);
+				pos += e.name_len;
+
+				if (sChecked.find(name) == sChecked.end())
+				{
+					uint64_t cur_size, cur_mtime, dat_size, dat_mtime;
+					ffc_stat(mpeg_path + name, cur_size, cur_mtime);
+					ffc_stat(ffc_dat_path(mpeg_path + name), dat_size, dat_mtime);
+
+					// the mpeg must be there, the .dat has to match whether it exists or not
+					result = (cur_size == e.size) && (cur_mtime == e.mtime) && (e.size != 0) &&
+						(dat_size == e.dat_size) && (dat_mtime == e.dat_mtime);
+					sChecked.insert(name);
+				}
+
+				m_mpeginfo[i].frame = e.frame;
+				m_mpeginfo[i].name = name;
+				m_bLastFileParsed = (e.dat_size != 0);
+			}
+
+			if (result)
+			{
+				m_mpeg_path = mpeg_path;
+				m_file_index = hdr.count;
+				m_bFramefileCompiled = true;
+				build_segment_map();
+				printf("Using compiled framefile %s.ffc\n", framefile_path.c_str());
+			}
+		}
+	}
+
+	MPO_FREE(buf);
+	mpo_close(io);
+
+	return result;
+}
+
+void ldp_vldp::save_compiled_framefile(const string &framefile_path)
+{
+	ffc_header hdr;
+	char ff_abs[PATH_MAX];
+
+	m_bFramefileCompiled = false;
+	if (!ffc_stat(framefile_path, hdr.ff_size, hdr.ff_mtime) || !realpath(framefile_path.c_str(), ff_abs))
+		return;
+
+	hdr.magic = FFC_MAGIC;
+	hdr.version = FFC_VERSION;
+	hdr.count = m_file_index;
+	hdr.ff_path_len = strlen(ff_abs);
+	hdr.mpeg_path_len = m_mpeg_path.length();
+	hdr.reserved = 0;
+
+	string blob((const char *) &hdr, sizeof(hdr));
+	blob += ff_abs;
+	blob += m_mpeg_path;
+
+	for (unsigned int i = 0; i < m_file_index; i++)
+	{
+		ffc_entry e;
+		const string &name = m_mpeginfo[i].name;
+
+		// a missing mpeg gets reported by first_video_file_exists, just don't compile that
+		if ((name.length() < 4) || !ffc_stat(m_mpeg_path + name, e.size, e.mtime))
+			return;
+		ffc_stat(ffc_dat_path(m_mpeg_path + name), e.dat_size, e.dat_mtime);
+
+		e.frame = m_mpeginfo[i].frame;
+		e.name_len = name.length();
+		blob.append((const char *) &e, sizeof(e));
+		blob += name;
+	}
+
+	mpo_io *io = mpo_open((framefile_path + ".ffc").c_str(), MPO_OPEN_CREATE);
+	if (io)
+	{
+		if (!mpo_write(blob.data(), blob.size(), NULL, io))
+			printf("LDP-VLDP: could not write %s.ffc\n", framefile_path.c_str());
+		mpo_close(io);
+	}
+}
+
 // if file does not exist, we print an error message
 bool ldp_vldp::first_video_file_exists()
 {
 	string full_path = "";
 	bool result = false;
 	
+	// a current compiled framefile means every file in it was just stat'ed
+	if (m_bFramefileCompiled)
+		return true;
+	
 	// if we have at least one file
 	if (m_file_index)
 	{
@@ -899,6 +1103,9 @@ bool ldp_vldp::last_video_file_parsed()
 {
 	string full_path = "";
 	
+	if (m_bFramefileCompiled)
+		return m_bLastFileParsed;
+
 	// if we have at least one file
 	if (m_file_index > 0)
 	{
@@ -936,6 +1143,128 @@ void ldp_vldp::parse_all_video()
 	}
 }
 
+// how many files get read ahead of VLDP at once (SD cards and USB sticks don't gain past a few)
+#define PRECACHE_THREADS 4
+
+// returns how many megs we can use without pushing something else out (0 if unknown)
+static unsigned int get_sys_mem()
+{
+	// MemAvailable includes page cache that can be dropped, which MemFree does not
+	FILE *f = fopen("/proc/meminfo", "r");
+	if (f)
+	{
+		char line[128];
+		unsigned long uKB = 0;
+		while (fgets(line, sizeof(line), f))
+		{
+			if (sscanf(line, "MemAvailable: %lu kB", &uKB) == 1)
+			{
+				fclose(f);
+				return (unsigned int) (uKB / 1024);
+			}
+		}
+		fclose(f);
+	}
+
+	// older kernels have no MemAvailable
+	struct sysinfo si;
+	if (sysinfo(&si) == 0)
+		return (unsigned int) (((uint64_t) si.freeram + si.bufferram) * si.mem_unit / 1048576);
+
+	return 0;
+}
+
+// one file to precache
+struct precache_job
+{
+	string name;
+	uint64_t size;
+	unsigned int refs;	// how many framefile entries use this file
+	unsigned int first;	// first framefile entry that uses it
+	bool warm;	// the pool has read the whole file, so VLDP will find it in the page cache
+	bool ok;
+};
+
+// Reads files ahead of VLDP with a few threads. VLDP can only precache one file at a time
+//  (it's a command to its own thread), so the win is having the next files already in
+//  the page cache by the time it gets to them.
+class precache_pool
+{
+public:
+	precache_pool(vector<precache_job> &jobs, const string &path) :
+		m_jobs(jobs), m_path(path), m_next(0), m_bytes(0)
+	{
+		unsigned int uThreads = thread::hardware_concurrency();
+		if (uThreads == 0 || uThreads > PRECACHE_THREADS) uThreads = PRECACHE_THREADS;
+		if (uThreads > m_jobs.size()) uThreads = m_jobs.size();
+
+		for (unsigned int i = 0; i < uThreads; i++)
+			m_threads.push_back(thread(&precache_pool::worker, this));
+	}
+
+	~precache_pool()
+	{
+		for (size_t i = 0; i < m_threads.size(); i++)
+			m_threads[i].join();
+	}
+
+	// blocks until m_jobs[idx] has been read (or up to uTimeoutMs), returns true once it has
+	bool wait(unsigned int idx, unsigned int uTimeoutMs)
+	{
+		unique_lock<mutex> lock(m_mutex);
+		return m_cond.wait_for(lock, chrono::milliseconds(uTimeoutMs), [&] { return m_jobs[idx].warm; });
+	}
+
+	uint64_t bytes_read() { return m_bytes; }
+
+private:
+	void worker()
+	{
+		const size_t CHUNK = 1024 * 1024;
+		unsigned char *buf = MPO_MALLOC(CHUNK);
+
+		for (;;)
+		{
+			unsigned int idx = m_next++;
+			if (idx >= m_jobs.size()) break;
+
+			bool bOK = false;
+			mpo_io *io = buf ? mpo_open((m_path + m_jobs[idx].name).c_str(), MPO_OPEN_READONLY) : NULL;
+			if (io)
+			{
+#ifndef _WIN32
+				posix_fadvise(fileno(io->handle), 0, 0, POSIX_FADV_WILLNEED);
+#endif
+				MPO_BYTES_READ bytes_read = 0;
+				while (mpo_read(buf, CHUNK, &bytes_read, io) && bytes_read > 0)
+				{
+					m_bytes += bytes_read;
+					if (bytes_read < CHUNK) break;
+				}
+				bOK = true;
+				mpo_close(io);
+			}
+
+			{
+				lock_guard<mutex> lock(m_mutex);
+				m_jobs[idx].ok = bOK;
+				m_jobs[idx].warm = true;
+			}
+			m_cond.notify_all();
+		}
+
+		MPO_FREE(buf);
+	}
+
+	vector<precache_job> &m_jobs;
+	string m_path;
+	atomic<unsigned int> m_next;
+	atomic<uint64_t> m_bytes;
+	vector<thread> m_threads;
+	mutex m_mutex;
+	condition_variable m_cond;
+};
+
 bool ldp_vldp::precache_all_video()
 {
 	bool bResult = true;
@@ -944,38 +1273,40 @@ bool ldp_vldp::precache_all_video()
 	string full_path = "";
 	mpo_io *io = NULL;
 
-	// to make sure the total file size is correct
-	// (it's legal for a framefile to have the same file listed more than once)
-	set<string> sDupePreventer;
+	// it's legal for a framefile to have the same file listed more than once,
+	//  every file only gets precached once
+	map<string, unsigned int> mJobIdx;
+	vector<precache_job> vJobs;
 
 	uint64_t u64TotalBytes = 0;
 
 	// first compute file size ...
 	for (i = 0; i < m_file_index; i++)
 	{
+		map<string, unsigned int>::iterator mi = mJobIdx.find(m_mpeginfo[i].name);
+		if (mi != mJobIdx.end())
+		{
+			vJobs[mi->second].refs++;
+			continue;
+		}
+
 		full_path = m_mpeg_path + m_mpeginfo[i].name;	// create full pathname to file
-		
-		// if this file's size hasn't already been taken into account
-		if (sDupePreventer.find(m_mpeginfo[i].name) == sDupePreventer.end())
+		io = mpo_open(full_path.c_str(), MPO_OPEN_READONLY);
+		if (io)
 		{
-			io = mpo_open(full_path.c_str(), MPO_OPEN_READONLY);
-			if (io)
-			{
-				u64TotalBytes += io->size;
-				mpo_close(io);	// we're done with this file ...
-				sDupePreventer.insert(m_mpeginfo[i].name);	// we've used it now ...
-			}
-			// else file can't be opened ...
-			else
-			{
-				printf("LDP-VLDP: when precaching, the file ");
-				//printf(full_path.c_str());
-				printf(" cannot be opened.");
-				bResult = false;
-				break;
-			}
-		} // end if the filesize hasn't been taken into account
-		// else the filesize has already been taken into account
+			precache_job job = { m_mpeginfo[i].name, io->size, 1, i, false, false };
+			u64TotalBytes += io->size;
+			mpo_close(io);	// we're done with this file ...
+			mJobIdx[m_mpeginfo[i].name] = vJobs.size();
+			vJobs.push_back(job);
+		}
+		// else file can't be opened ...
+		else
+		{
+			printf("LDP-VLDP: when precaching, the file %s cannot be opened.\n", full_path.c_str());
+			bResult = false;
+			break;
+		}
 	}
 
 	// if we were able to compute the file size ...
@@ -983,41 +1314,82 @@ bool ldp_vldp::precache_all_video()
 	{
 		const unsigned int uFUDGE = 256;	// how many megs we assume the OS needs in addition to our application running
 		unsigned int uReqMegs = (unsigned int) ((u64TotalBytes / 1048576) + uFUDGE);
-		//unsigned int uMegs = get_sys_mem();
-
-		// if we have enough memory (accounting for OS overhead, which may need to increase in the future)
-		//  OR if the user wants to force precaching despite our check ...
-		if (/*(uReqMegs < uMegs) || */ (m_bPreCacheForce))
+		unsigned int uMegs = get_sys_mem();
+
+		// if we don't have enough memory (accounting for OS overhead, which may need to increase in the future)
+		//  AND the user doesn't want to force precaching despite our check,
+		//  then precache what fits, starting with the files the framefile uses most
+		//  (and among those the earliest, which is where attract mode and the start of the game are)
+		// If we can't tell how much memory there is, there is nothing to check against, so precache it all
+		if (uMegs == 0)
 		{
-			for (i = 0; i < m_file_index; i++)
+			printf("LDP-VLDP: can't tell how much memory is available, precaching all %u files (%u megs) without checking.\n",
+				(unsigned int) vJobs.size(), uReqMegs);
+		}
+		else if ((uReqMegs >= uMegs) && (!m_bPreCacheForce))
+		{
+			sort(vJobs.begin(), vJobs.end(), [](const precache_job &a, const precache_job &b)
+				{ return (a.refs != b.refs) ? (a.refs > b.refs) : (a.first < b.first); });
+
+			uint64_t u64Budget = (uMegs > uFUDGE) ? ((uint64_t) (uMegs - uFUDGE)) * 1048576 : 0;
+			vector<precache_job> vFits;
+			for (i = 0; i < vJobs.size(); i++)
 			{
-				// if the file in question has not yet been precached
-				if (m_mPreCachedFiles.find(m_mpeginfo[i].name) == m_mPreCachedFiles.end())
+				if (vJobs[i].size <= u64Budget)
 				{
-					// try to precache and if it fails, bail ...
-					if (precache_and_block(m_mpeginfo[i].name))
-					{
-						// store the index of the file that we last precached
-						m_mPreCachedFiles[m_mpeginfo[i].name] = g_vldp_info->uLastCachedIndex;
-					}
-					else
-					{
-						full_path = m_mpeg_path + m_mpeginfo[i].name;
-
-						printf("LDP-VLDP: precaching of file ");
-						//printf(full_path.c_str());
-						printf(" failed.");
-						bResult = false;
-					}
-				} // end if file has not been precached
-				// else file has already been precached, so don't precache it again
+					u64Budget -= vJobs[i].size;
+					vFits.push_back(vJobs[i]);
+				}
 			}
+
+			printf("Not enough memory to precache video stream (%u megs needed, %u available), precaching %u of %u files.\n",
+				uReqMegs, uMegs, (unsigned int) vFits.size(), (unsigned int) vJobs.size());
+			vJobs.swap(vFits);
+
+			if (vJobs.empty()) bResult = false;
 		}
-		else
+
+		// drop anything that is already precached
+		for (i = 0; i < vJobs.size(); )
 		{
-			printf("Not enough memory to precache video stream.");
-			//numstr::ToStr(uReqMegs)).c_str());
-			bResult = false;
+			if (m_mPreCachedFiles.find(vJobs[i].name) != m_mPreCachedFiles.end())
+				vJobs.erase(vJobs.begin() + i);
+			else
+				i++;
+		}
+
+		uint64_t u64JobBytes = 0;
+		for (i = 0; i < vJobs.size(); i++) u64JobBytes += vJobs[i].size;
+
+		if (bResult && !vJobs.empty())
+		{
+			report_parse_progress_callback(-1);	// new parse starting
+
+			precache_pool pool(vJobs, m_mpeg_path);
+			uint64_t u64Cached = 0;
+
+			for (i = 0; i < vJobs.size(); i++)
+			{
+				// half of the progress is reading, the other half is VLDP taking the file in
+				while (!pool.wait(i, 100))
+					report_parse_progress_callback((double) (pool.bytes_read() + u64Cached) / (2.0 * u64JobBytes));
+
+				// try to precache and if it fails, bail ...
+				if (vJobs[i].ok && precache_and_block(vJobs[i].name))
+				{
+					// store the index of the file that we last precached
+					m_mPreCachedFiles[vJobs[i].name] = g_vldp_info->uLastCachedIndex;
+				}
+				else
+				{
+					full_path = m_mpeg_path + vJobs[i].name;
+					printf("LDP-VLDP: precaching of file %s failed.\n", full_path.c_str());
+					bResult = false;
+				}
+
+				u64Cached += vJobs[i].size;
+				report_parse_progress_callback((double) (pool.bytes_read() + u64Cached) / (2.0 * u64JobBytes));
+			}
 		}
 	}
 
@@ -1049,13 +1421,11 @@ uint64_t ldp_vldp::get_audio_sample_position(unsigned int uTargetMpegFrame)
 //  return frames if they are at the same FPS (which hopefully they are hehe)
 uint16_t ldp_vldp::mpeg_info (string &filename, uint16_t ld_frame)
 {
-	unsigned int index = 0;
 	uint16_t mpeg_frame = 0;	// which mpeg frame to seek (assuming mpeg and disc have same FPS)
 	filename = "";	// blank 'filename' means error, so we default to this condition for safety reasons
 	
 	// find the mpeg file that has the LD frame inside of it
-	while ((index+1 < m_file_index) && (ld_frame >= m_mpeginfo[index+1].frame))
-		index = index + 1;
+	unsigned int index = find_segment(ld_frame);
 
 	// make sure that the frame they've requested comes after the first frame in our framefile
 	if (ld_frame >= m_mpeginfo[index].frame)
@@ -1078,6 +1448,45 @@ uint16_t ldp_vldp::mpeg_info (string &filename, uint16_t ld_frame)
 	return(mpeg_frame);
 }
 
+void ldp_vldp::build_segment_map()
+{
+	m_segmap_limit.clear();
+	m_segmap_dense.clear();
+	m_segmap_files = m_file_index;
+
+	// The old lookup walked forward while the next segment started at or before the frame.
+	// Keeping the running maximum of the start frames makes that a sorted array, so the
+	//  answer stays the same even for a framefile that isn't in order.
+	int32_t limit = INT32_MIN;
+	for (unsigned int i = 1; i < m_file_index; i++)
+	{
+		if (m_mpeginfo[i].frame > limit) limit = m_mpeginfo[i].frame;
+		m_segmap_limit.push_back(limit);
+	}
+
+	// past the last limit every frame is in the last segment, so the table only needs to get that far
+	if (!m_segmap_limit.empty() && (limit >= 0) && (limit < SEGMAP_DENSE_FRAMES))
+	{
+		m_segmap_dense.resize(limit + 1);
+		unsigned int index = 0;
+		for (int32_t frame = 0; frame <= limit; frame++)
+		{
+			while ((index < m_segmap_limit.size()) && (m_segmap_limit[index] <= frame)) ++index;
+			m_segmap_dense[frame] = (uint16_t) index;
+		}
+	}
+}
+
+unsigned int ldp_vldp::find_segment(uint16_t ld_frame)
+{
+	// m_mpeginfo can be filled without going through read_frame_conversions (releasetest)
+	if (m_segmap_files != m_file_index) build_segment_map();
+
+	if (ld_frame < m_segmap_dense.size()) return m_segmap_dense[ld_frame];
+
+	return upper_bound(m_segmap_limit.begin(), m_segmap_limit.end(), (int32_t) ld_frame) - m_segmap_limit.begin();
+}
+
 bool ldp_vldp::parse_framefile(const char *pszInBuf, const char *pszFramefileFullPath,
 							   string &sMpegPath, struct fileframes *pFrames, unsigned int &frame_idx, unsigned int max_frames, string &err_msg)
 {
@@ -1213,6 +1622,8 @@ bool ldp_vldp::parse_framefile(const char *pszInBuf, const char *pszFramefileFul
 uint32_t g_parse_start_time = 0;	// when mpeg parsing began approximately ...
 double g_parse_start_percentage = 0.0;	// the first percentage report we received ...
 bool g_parsed = false;	// whether we've received any data at all ...
+double g_dPercentComplete01 = 0.0;	// last progress report, between 0 and 1 (negative before the first one)
+bool g_bGotParseUpdate = false;	// whether a progress report came in since the meter was last drawn
 
 // this should be called from parent thread
 //void update_parse_meter()
@@ -1276,18 +1687,18 @@ bool g_parsed = false;	// whether we've received any data at all ...
 
 // percent_complete is between 0 and 1
 // a negative value means that we are starting to parse a new file NOW
-//void report_parse_progress_callback(double percent_complete_01)
-//{
-//	g_dPercentComplete01 = percent_complete_01;
-//	g_bGotParseUpdate = true;
-//	g_parsed = true;	// so we can know to re-create the overlay
-//
-//	// if a new parse is starting
-//	if (percent_complete_01 < 0)
-//	{
-//		// NOTE : this would be a good place to automatically free the yuv overlay
-//		// BUT it was causing crashes... free_yuv_overlay here if you find any compatibility problems on other platforms
+void report_parse_progress_callback(double percent_complete_01)
+{
+	g_dPercentComplete01 = percent_complete_01;
+	g_bGotParseUpdate = true;
+	g_parsed = true;	// so we can know to re-create the overlay
+
+	// if a new parse is starting
+	if (percent_complete_01 < 0)
+	{
+		// NOTE : this would be a good place to automatically free the yuv overlay
+		// BUT it was causing crashes... free_yuv_overlay here if you find any compatibility problems on other platforms
 //		g_parse_start_time = refresh_ms_time();
-//		g_parse_start_percentage = 0;
-//	}
-//}
+		g_parse_start_percentage = 0;
+	}
+}
@@ -28,6 +28,7 @@
 #include <string>
 #include <list>
 #include <map>
+#include <vector>
 
 #include "fileparse.h"
 
@@ -42,6 +43,9 @@ enum { VLDP_FALSE = 0, VLDP_TRUE = 1 }; typedef int VLDP_BOOL;
 // maximum # of mpeg files that we will handle
 #define MAX_MPEG_FILES 500
 
+// discs whose last segment starts below this frame get a lookup table entry per frame
+#define SEGMAP_DENSE_FRAMES 32768
+
 struct fileframes
 {
 	string name;	// name of mpeg file
@@ -108,6 +112,10 @@ public:
  
 private:
 	bool read_frame_conversions();
+
+	// <framefile>.ffc, the parsed framefile plus what it was parsed against (see ldp-vldp.cpp)
+	bool load_compiled_framefile(const string &framefile_path);
+	void save_compiled_framefile(const string &framefile_path);
 	bool first_video_file_exists();
 	bool last_video_file_parsed();
 	void parse_all_video();
@@ -122,6 +130,12 @@ private:
 
 	// NOTE : 'filename' does not include the prefix path
 	uint16_t mpeg_info (string &filename, uint16_t ld_frame);
+
+	// compiles m_mpeginfo into m_segmap_limit/m_segmap_dense, must be redone whenever m_mpeginfo changes
+	void build_segment_map();
+
+	// index into m_mpeginfo of the segment holding ld_frame (same answer as scanning the list in order)
+	unsigned int find_segment(uint16_t ld_frame);
 	
 	int32_t m_target_mpegframe;	// mpeg frame # we are seeking to
 	int32_t m_cur_ldframe_offset;	// which laserdisc frame corresponds to the first frame in current mpeg file
@@ -135,6 +149,15 @@ private:
 	struct fileframes m_mpeginfo[MAX_MPEG_FILES]; // names of mpeg files
 	unsigned int m_file_index; // # of mpeg files in our list
 
+	// m_segmap_limit[i] is the highest start frame among segments 1..i+1, a frame belongs to
+	//  the first segment i whose limit is above it (or to the last one)
+	vector<int32_t> m_segmap_limit;
+	vector<uint16_t> m_segmap_dense;	// find_segment() result per frame, when the disc is small enough
+	unsigned int m_segmap_files;	// m_file_index the map was built for
+
+	bool m_bFramefileCompiled;	// m_mpeginfo came from a current compiled framefile, so every file in it exists
+	bool m_bLastFileParsed;	// whether the last file had a .dat when the framefile was compiled
+
 	bool m_bFramefileSet;	// whether m_framefile was set via commandline or if it's just the default from the constructor
 	bool m_audio_file_opened;	// whether we have audio to accompany the video
 	bool m_blank_on_searches;	// should we blank while searching?
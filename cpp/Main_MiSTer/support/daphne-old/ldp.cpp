@@ -491,8 +491,7 @@ void ldp::pre_play()
 		m_uBlockedMsSincePlay = 0;	// " " "
 		m_iSkipOffsetSincePlay = 0;	// by definition, this must be reset since we are playing
 		m_uCurrentOffsetFrame = 0;	// " " "
-		//m_uMsFrameBoundary = 1000000 / g_game->get_disc_fpks();	// how many ms must elapse before the first frame ends, 2nd frame begins
-		m_uMsFrameBoundary = 1000000 / 23.976;	// how many ms must elapse before the first frame ends, 2nd frame begins
+		m_uMsFrameBoundary = 1000000 / get_disc_fpks();	// how many ms must elapse before the first frame ends, 2nd frame begins
 
 		// VLDP needs its timer reset with the rest of these timers before its play command is called.
 		// Otherwise, it will think it's way behind and will try to catch up a bunch of frames.
@@ -649,27 +648,9 @@ void ldp::think_delay(unsigned int uMsDelay)
 		//set_quitflag();
 	}
 
-	// call pre_think the same # of times that uMsDelay tells us to,
+	// advance the same as calling pre_think uMsDelay times,
 	//  to ensure that we aren't caught sleeping during an important event
-	for (unsigned int uMs = 0; uMs < uMsDelay; ++uMs)
-	{
-		pre_think();
-//
-//		unsigned int uElapsedMs = elapsed_ms_time(m_start_time);
-//
-//		// if we're ahead of where we need to be, then it's ok to stall ...
-//		if (uElapsedMs < m_uElapsedMsSinceStart)
-//		{
-//			/*
-//			string msg = "uElapsedMs is " + numstr::ToStr(uElapsedMs) + " and m_uElapsedMssinceStart is " +
-//				numstr::ToStr(m_uElapsedMsSinceStart);
-//			printline(msg.c_str());	// REMOVE ME
-//			*/
-//
-//			//MAKE_DELAY(1);
-//		}
-//		// otherwise we're caught up or behind, so just loop so we can make sure we're caught up
-	}
+	advance_ms(uMsDelay);
 }
 
 // TODO: in the future, we may want to support vblank of 50 hz for the PAL laserdisc games
@@ -682,10 +663,82 @@ void ldp::pre_think()
 	//  (and should be) used instead of calling this function directly.
 	// IMPORTANT : this must be updated no matter what because vldp relies on this timer when we're paused
 
-	// START VBLANK COUNT
-
 	// at the end of this function, if vblank gets asserted, we need to call an event handler in the game class, but we
 	//  need to do that after the frame number has been recalculated (if need be), hence the purpose of this variable.
+	bool bVblankAsserted = step_ms();
+
+	think();	// call implementation-specific function
+
+	// If vblank was asserted, let game know about it...
+	// NOTE : this should probably come at the end of this function
+	if (bVblankAsserted)
+	{
+		// let game know about vblank ...
+		//g_game->OnVblank();
+	}
+}
+
+unsigned int ldp::get_ms_to_next_event()
+{
+	// 1-based: the ms on which step_ms() would fire the vblank
+	unsigned int uNext = 1;
+	if (m_uMsVblankBoundary > m_uElapsedMsSinceStart) uNext = m_uMsVblankBoundary - m_uElapsedMsSinceStart;
+
+	if (m_status == LDP_PLAYING)
+	{
+		unsigned int uDiscFPKS = get_disc_fpks();
+
+		// in sync with vblank, frames only change on a vblank unless 2 are already counted
+		if ((uDiscFPKS << 1) == VBLANKS_PER_KILOSECOND)
+		{
+			if (m_uVblankMiniCount > 1) uNext = 1;
+		}
+		else if (m_uElapsedMsSincePlay >= m_uMsFrameBoundary)
+		{
+			uNext = 1;
+		}
+		// the play timer only runs once we are past the first vblank
+		else if (!m_bWaitingForVblankToPlay)
+		{
+			unsigned int uFrame = m_uMsFrameBoundary - m_uElapsedMsSincePlay;
+			if (uFrame < uNext) uNext = uFrame;
+		}
+	}
+
+	return uNext - 1;
+}
+
+void ldp::advance_ms(unsigned int uMs)
+{
+	while (uMs)
+	{
+		// nothing changes but the two timers until the next event, so skip straight to it
+		unsigned int uIdle = get_ms_to_next_event();
+		if (uIdle >= uMs)
+		{
+			uIdle = uMs;
+		}
+		m_uElapsedMsSinceStart += uIdle;
+		if (!m_bWaitingForVblankToPlay)
+		{
+			m_uElapsedMsSincePlay += uIdle;
+		}
+		uMs -= uIdle;
+
+		if (uMs)
+		{
+			step_ms();
+			--uMs;
+		}
+	}
+
+	think();	// call implementation-specific function
+}
+
+bool ldp::step_ms()
+{
+	// START VBLANK COUNT
+
 	bool bVblankAsserted = false;
 
 	++m_uElapsedMsSinceStart;
@@ -730,9 +783,7 @@ void ldp::pre_think()
 	// Be very careful about changing this 'm_status' to a get_status()
 	if (m_status == LDP_PLAYING)
 	{
-	    //TODO lair fpks here
-		//unsigned int uDiscFPKS = g_game->get_disc_fpks();
-		unsigned int uDiscFPKS = 23.976;
+		unsigned int uDiscFPKS = get_disc_fpks();
 
 		// if our frame counter is in sync with vblank, then just increment frame every 2 vblanks ...
 		if ((uDiscFPKS << 1) == VBLANKS_PER_KILOSECOND)
@@ -758,15 +809,14 @@ void ldp::pre_think()
 	}
 	// otherwise the disc is idle, so we need not change the current frame
 
-	think();	// call implementation-specific function
+	return bVblankAsserted;
+}
 
-	// If vblank was asserted, let game know about it...
-	// NOTE : this should probably come at the end of this function
-	if (bVblankAsserted)
-	{
-		// let game know about vblank ...
-		//g_game->OnVblank();
-	}
+// Dragon's Lair's disc runs at 23.976 fps.  There is no game driver to ask yet,
+// so every frame timing calculation takes the rate from here.
+unsigned int ldp::get_disc_fpks()
+{
+	return 23976;
 }
 
 // DO NOT CALL THIS FUCTION DIRECTLY!  THIS FUCTION IS JUST A HELPER FOR PRE_THINK!
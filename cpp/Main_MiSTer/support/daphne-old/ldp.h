@@ -149,6 +149,15 @@ public:
 	// pre_think() calls think() for ldp-specific stuff
 	virtual void think();
 
+	// Same result as calling pre_think() uMs times, but jumps straight from one vblank or frame
+	// boundary to the next, so a long idle stretch costs a handful of steps instead of one per ms.
+	// think() is only called once, at the end.
+	void advance_ms(unsigned int uMs);
+
+	// How many ms until pre_think() would next change a vblank or frame counter,
+	// so the caller can sleep until then. Returns 0 if that could happen on the very next ms.
+	unsigned int get_ms_to_next_event();
+
 	// returns the current frame number that the disc is on
 	// this is a generic function which computes the current frame number using the elapsed time
 	// and the framerate of the disc.  Obviously querying the laserdisc player would be preferable
@@ -219,6 +228,12 @@ protected:
 	// helper function, shouldn't be called directly
 	void increment_current_frame();
 
+	// one ms of pre_think() without the think() call, returns true if vblank was asserted
+	bool step_ms();
+
+	// frames per kilosecond of the disc, stands in for g_game->get_disc_fpks()
+	unsigned int get_disc_fpks();
+
 	bool need_serial;	// whether this LDP driver needs the serial port initialized
 	bool serial_initialized; // whether serial has been initialized
 	bool player_initialized; // whether the LDP has been properly initialized
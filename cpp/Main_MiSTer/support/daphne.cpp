@@ -1,9 +1,12 @@
 #include "../file_io.h"
 #include "../user_io.h"
 #include "../spi.h"
+#include "daphne.h"
+#include "daphne_lib.h"
 
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 
 ////////////// VLDP ///////////////
 
@@ -16,8 +19,15 @@ static char selected_path[1024] = {};
 static uint8_t buf[1024];
 static char has_mpeg = 0;
 static fileTYPE f_audio = {};
-static fileTYPE f_mpeg = {};
 static fileTYPE f_index = {};
+static daphne_stream_stats stats = {};
+
+static uint64_t stats_now_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
 
 /*
 static void daphne_send_command(uint64_t cmd)
@@ -33,33 +43,39 @@ static void daphne_send_command(uint64_t cmd)
 int daphne_send_mpeg_data()
 {
 	int chunk = sizeof(buf);
+	uint64_t start = stats_now_ns();
 
 	memset(buf, 0, chunk);
-	// TODO fix this size thing... it needs to be there
-	//if (&f_mpeg->size) FileReadAdv(&f_mpeg, buf, chunk);
-	FileReadAdv(&f_mpeg, buf, chunk);
+	// segments are chained by the library, a short read only happens at the end of the disc
+	if (daphne_lib_read(buf, chunk) < chunk) stats.short_reads++;
 
 	user_io_set_index(2);
 	user_io_set_download(1);
 	user_io_file_tx_data(buf, chunk);
 	user_io_set_download(0);
 
+	uint64_t took = stats_now_ns() - start;
+	stats.requests++;
+	stats.bytes += chunk;
+	stats.service_ns += took;
+	if (took > stats.service_ns_max) stats.service_ns_max = took;
+
 	return 1;
 }
 
-void daphne_init()
+void daphne_init(const char *framefile)
 {
-	static fileTYPE f = {};
 	//FileClose(&f_audio);
     //selected_path = "";
-	has_mpeg = FileOpen(&f, "/wilson/current/Daphne_MiSTer/verilator/lair.m2v") ? 1 : 0;
-	uint32_t size = f.size;
-	FileClose(&f);
+	has_mpeg = daphne_lib_open(framefile) ? 1 : 0;
+	user_io_update_width();
 
     // TODO send size and/or index file?
-	if (size)// && size < 0x1F200000)
+	if (has_mpeg)
 	{
-	    FileOpen(&f_mpeg, "/wilson/current/Daphne_MiSTer/verilator/lair.m2v");
+		stats.seek_frame = daphne_lib_segment_frame(0);
+		daphne_lib_seek(stats.seek_frame);
+		stats.seeks++;
 		//msu_send_command((0x20600000ULL << 16) | MSU_DATA_BASE);
 		//user_io_file_tx(selected_path, 3, 0, 0, 0, 0x20600000);
 	}
@@ -67,6 +83,16 @@ void daphne_init()
 	//msu_send_command((has_cd << 15) | MSU_CD_SET);
 }
 
+const daphne_stream_stats *daphne_get_stats()
+{
+	return &stats;
+}
+
+void daphne_reset_stats()
+{
+	memset(&stats, 0, sizeof(stats));
+}
+
 uint8_t request_latch = 0;
 uint8_t last_req = 255;
 uint8_t req = 255;
@@ -81,12 +107,9 @@ uint8_t daphne_poll(void)
 	{
         last_req = req;
 
-        // TODO this will need to be got through spi_w
-		uint16_t command = req;
-
-		//uint16_t command = spi_w(0);
-		//uint32_t data = spi_w(0);
-		//data = (spi_w(0) << 16) | data;
+		uint16_t command = spi_w(0);
+		uint32_t data = spi_w(0);
+		data = (spi_w(0) << 16) | data;
 
 		DisableIO();
 		switch(command)
@@ -119,7 +142,7 @@ uint8_t daphne_poll(void)
 	}
 	else
 	{
-		//DisableIO();
+		DisableIO();
 	}
 
 	return 0;
@@ -1,8 +1,25 @@
 #ifndef DAPHNE_H
 #define DAPHNE_H
 
+#include <stdint.h>
+
+// transport counters, used by the streaming benchmarks
+struct daphne_stream_stats
+{
+	uint32_t requests;        // sector requests served
+	uint32_t short_reads;     // requests that ran off the end of the disc
+	uint64_t bytes;           // bytes handed to user_io_file_tx_data
+	uint64_t service_ns;      // total time spent serving requests
+	uint64_t service_ns_max;  // slowest request
+	uint32_t seeks;           // times the stream was moved to a new frame
+	int32_t  seek_frame;      // laserdisc frame of the last seek
+};
+
 uint8_t daphne_poll(void);
-uint8_t daphne_send_mpeg_data(void);
-void daphne_init();
+int daphne_send_mpeg_data(void);
+void daphne_init(const char *framefile);
+
+const daphne_stream_stats *daphne_get_stats();
+void daphne_reset_stats();
 
 #endif
\ No newline at end of file
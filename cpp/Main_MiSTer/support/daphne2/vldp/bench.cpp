@@ -0,0 +1,252 @@
+// Micro-benchmarks for the VLDP index and seek paths
+//
+//  ./vldp_bench [-f file.m2v] [-s MB] [-w warmups] [-r runs] [-l lookups] [-k]
+//
+// Times, over the same open stream:
+//   parse     - parse_video_stream over the whole file, writing a fresh .dat
+//   dat load  - ivldp_get_mpeg_frame_offsets reading an existing .dat
+//   seek pick - the I frame decision idle_handler_search makes, per random target
+//   precache  - loading the whole file into RAM as a precached segment
+//
+// Without -f a synthetic stream of -s MB is written to bench.m2v: the lair
+// sequence header (lair-head.m2v) followed by IBBPBBPBBPBBPBB GOPs, so the
+// parser sees the same start code mix as a real disc.
+
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <ctime>
+#include <vector>
+#include <algorithm>
+#include "vldp.h"
+#include "vldp_common.h"
+
+#define BENCH_FILE "bench.m2v"
+#define BENCH_HEAD "lair-head.m2v"
+#define BENCH_FRAMES 54000	// stays under MAX_LDP_FRAMES with room to spare
+#define BENCH_GOP 15
+
+static double bench_now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned int bench_ticks()
+{
+	return (unsigned int) (bench_now() * 1000);
+}
+
+static void bench_progress(double) {}
+static void bench_blank() {}
+
+static void bench_dat_name(char *dst, const char *m2v)
+{
+	// same rule VLDP uses, the extension is swapped for dat
+	strcpy(dst, m2v);
+	strcpy(&dst[strlen(m2v) - 3], "dat");
+}
+
+static bool bench_write_picture(FILE *f, int type, unsigned int size)
+{
+	static const uint8_t coding_ext[] = { 0x00, 0x00, 0x01, 0xB5, 0x83, 0x4F, 0xF3, 0x59, 0x80 };	// frame picture
+	static uint8_t filler[65536];
+	uint8_t pic[8] = { 0x00, 0x00, 0x01, 0x00, 0x00, (uint8_t) (type << 3), 0xFF, 0xF8 };
+	uint8_t slice[4] = { 0x00, 0x00, 0x01, 0x01 };
+
+	if (!filler[0]) memset(filler, 0x55, sizeof(filler));	// never forms a start code
+
+	fwrite(pic, sizeof(pic), 1, f);
+	fwrite(coding_ext, sizeof(coding_ext), 1, f);
+	fwrite(slice, sizeof(slice), 1, f);
+
+	size -= sizeof(pic) + sizeof(coding_ext) + sizeof(slice);
+	while (size) {
+		unsigned int chunk = std::min(size, (unsigned int) sizeof(filler));
+		if (fwrite(filler, chunk, 1, f) != 1) return false;
+		size -= chunk;
+	}
+	return true;
+}
+
+static bool bench_make_stream(const char *name, unsigned int mb)
+{
+	static const uint8_t gop[8] = { 0x00, 0x00, 0x01, 0xB8, 0x00, 0x08, 0x00, 0x00 };
+	uint8_t head[256];
+	size_t head_len;
+	FILE *f;
+
+	f = fopen(BENCH_HEAD, "rb");
+	if (!f) {
+		fprintf(stderr, "BENCH : can't open %s for the sequence header\n", BENCH_HEAD);
+		return false;
+	}
+	head_len = fread(head, 1, sizeof(head), f);
+	fclose(f);
+
+	// I:P:B sizes are 4:2:1, so a GOP is 22 units
+	uint64_t total = (uint64_t) mb << 20;
+	unsigned int gops = BENCH_FRAMES / BENCH_GOP;
+	unsigned int unit = (unsigned int) ((total - head_len) / gops / 22);
+	if (unit < 64) unit = 64;
+
+	f = fopen(name, "wb");
+	if (!f) return false;
+
+	fwrite(head, head_len, 1, f);
+	bool ok = true;
+	for (unsigned int g = 0; ok && g < gops; g++) {
+		fwrite(gop, sizeof(gop), 1, f);
+		for (int i = 0; ok && i < BENCH_GOP; i++) {
+			int type = (i == 0) ? 1 : (i % 3 == 0) ? 2 : 3;
+			ok = bench_write_picture(f, type, unit * ((type == 1) ? 4 : (type == 2) ? 2 : 1));
+		}
+	}
+	fclose(f);
+
+	if (!ok) remove(name);
+	return ok;
+}
+
+struct BenchResult {
+	const char *name;
+	std::vector<double> secs;
+	double bytes;	// per run, 0 if throughput is meaningless
+	double ops;	// per run, 0 if per-op time is meaningless
+};
+
+static void bench_report(const BenchResult &r)
+{
+	std::vector<double> s = r.secs;
+	std::sort(s.begin(), s.end());
+
+	double mean = 0, var = 0;
+	for (double v : s) mean += v;
+	mean /= s.size();
+	for (double v : s) var += (v - mean) * (v - mean);
+	double sd = (s.size() > 1) ? sqrt(var / (s.size() - 1)) : 0;
+	double med = (s.size() & 1) ? s[s.size() / 2] : (s[s.size() / 2 - 1] + s[s.size() / 2]) / 2;
+
+	printf("%-10s min %9.3f  med %9.3f  mean %9.3f  sd %7.3f (%4.1f%%)  max %9.3f ms",
+		r.name, s.front() * 1e3, med * 1e3, mean * 1e3, sd * 1e3, mean ? 100 * sd / mean : 0, s.back() * 1e3);
+	if (r.bytes) printf("  %8.1f MB/s", r.bytes / med / 1048576);
+	if (r.ops) printf("  %8.1f ns/op", med * 1e9 / r.ops);
+	printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+	const char *file = NULL;
+	unsigned int mb = 1024;
+	int warmups = 1;
+	int runs = 5;
+	unsigned int lookups = 1000000;
+	bool keep = false;
+	char dat[320];
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-f") && i + 1 < argc) file = argv[++i];
+		else if (!strcmp(argv[i], "-s") && i + 1 < argc) mb = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-w") && i + 1 < argc) warmups = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-r") && i + 1 < argc) runs = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-l") && i + 1 < argc) lookups = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-k")) keep = true;
+		else {
+			fprintf(stderr, "usage: %s [-f file.m2v] [-s MB] [-w warmups] [-r runs] [-l lookups] [-k]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (warmups < 0) warmups = 0;
+	if (runs < 1) runs = 1;
+	if (mb < 1 || mb > 4000) mb = 1024;	// VLDP file offsets are 32 bit
+
+	static struct vldp_in_info info;
+	info.report_parse_progress = bench_progress;
+	info.render_blank_frame = bench_blank;
+	info.GetTicksFunc = bench_ticks;
+	unsetenv("VLDP_TRACE");	// the bench calls VLDP's internals directly, there'd be nothing to record
+	vldp_init(&info);
+
+	if (!file) {
+		file = BENCH_FILE;
+		printf("BENCH - writing %u MB synthetic stream to %s\n", mb, file);
+		if (!bench_make_stream(file, mb)) {
+			fprintf(stderr, "BENCH : couldn't write %s\n", file);
+			return 1;
+		}
+	}
+	bench_dat_name(dat, file);
+
+	// open once, this parses the stream if there is no .dat yet
+	strcpy(g_req_file, file);
+	open();
+	if (g_out_info.status != STAT_STOPPED) {
+		fprintf(stderr, "BENCH : VLDP couldn't open %s\n", file);
+		return 1;
+	}
+
+	FILE *f = fopen(file, "rb");
+	fseek(f, 0, SEEK_END);
+	double file_bytes = (double) ftell(f);
+	fclose(f);
+
+	unsigned int frames = vldp_load_frame_offsets(file);
+	if (!frames) {
+		fprintf(stderr, "BENCH : %s has no frames\n", file);
+		return 1;
+	}
+	printf("BENCH - %s: %.1f MB, %u frames, %d warm-up + %d timed runs\n", file, file_bytes / 1048576, frames, warmups, runs);
+
+	BenchResult parse = { "parse", {}, file_bytes, 0 };
+	BenchResult load = { "dat load", {}, (double) frames * 4, 0 };
+	BenchResult seek = { "seek pick", {}, 0, (double) lookups };
+	BenchResult cache = { "precache", {}, file_bytes, 0 };
+	uint64_t sink = 0;
+
+	// negative passes are warm-ups, they fill the page cache and aren't recorded
+	for (int i = -warmups; i < runs; i++) {
+		double t;
+
+		remove(dat);
+		t = bench_now();
+		if (vldp_load_frame_offsets(file) != frames) fprintf(stderr, "BENCH : parse found a different frame count\n");
+		t = bench_now() - t;
+		if (i >= 0) parse.secs.push_back(t);
+
+		t = bench_now();
+		vldp_load_frame_offsets(file);
+		t = bench_now() - t;
+		if (i >= 0) load.secs.push_back(t);
+
+		uint32_t seed = 12345 + i;
+		t = bench_now();
+		for (unsigned int n = 0; n < lookups; n++) {
+			int skip;
+			seed = seed * 1103515245 + 12345;
+			sink += vldp_seek_position((uint16_t) ((seed >> 8) % frames), &skip) + skip;
+		}
+		t = bench_now() - t;
+		if (i >= 0) seek.secs.push_back(t);
+
+		t = bench_now();
+		vldp_precache_req();
+		t = bench_now() - t;
+		if (g_out_info.status != STAT_STOPPED) fprintf(stderr, "BENCH : precache failed\n");
+		vldp_precache_release();
+		if (i >= 0) cache.secs.push_back(t);
+	}
+
+	bench_report(parse);
+	bench_report(load);
+	bench_report(seek);
+	bench_report(cache);
+	printf("BENCH - seek checksum %llx\n", (unsigned long long) sink);	// also keeps the lookups from being optimised away
+
+	if (!keep && !strcmp(file, BENCH_FILE)) {
+		remove(file);
+		remove(dat);
+	}
+	return 0;
+}
@@ -63,6 +63,7 @@ Sample mpeg2 byte sequence: 00 00 01 B5 25 06 06 06 0B 42 0F 00
 #include <stdio.h>
 #include <stdlib.h>	// for malloc
 #include "mpegscan.h"
+#include "vldp_common.h"	// the parser reads the stream through vldp_io_read
 
 unsigned char g_last_three[3] = { 0 };		// the last 3 bytes read
 unsigned int g_last_three_loc[3] = { 0 };	// the position of the last 3 bytes read
@@ -198,9 +199,7 @@ int parse_video_stream(FILE *datafile, unsigned int length)
 		return P_ERROR;
 	}
 
-	// RJS CHANGE - Um, what was this compiled on?
-	// bytes_read = io_read(buf, length);	// read in a chunk
-	bytes_read = fread(buf, length, 1, datafile);
+	bytes_read = vldp_io_read(buf, length);	// read in a chunk
 
 	// parse this chunk of video
 	while (g_filepos  - start_pos < length)
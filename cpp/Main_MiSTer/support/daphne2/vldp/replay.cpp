@@ -0,0 +1,328 @@
+// Replays a recorded seek trace against VLDP as fast as possible
+//
+//  ./vldp_replay [-d dir] [-o commands.csv] [-v] trace.txt
+//
+// To capture a session, run the player with VLDP_TRACE=<file> in its environment
+// (vldp_init() then records everything until shutdown), or call
+// vldp_out_info::trace yourself.  One command per line:
+//   <ms> open <file>            <ms> search <frame> <min_seek_ms>
+//   <ms> openp <idx> <file>     <ms> skip <frame>
+//   <ms> precache <file>        <ms> play <timer>
+//   <ms> pause                  <ms> step
+//   <ms> speed <skip> <stall>
+// Lines starting with # are comments.
+//
+// There's no decoder on this side, so a search or skip is finished once the
+// stream has been read past the requested picture, in the same chunk size
+// ivldp_render uses.  While playing, the time between two commands is turned
+// into pictures read at the stream's frame rate (and play speed), so the
+// bytes read are what the session would have pulled from the file.
+//
+//  -d dir   look for the trace's files in dir instead of their recorded path
+//  -o file  write one CSV line per command
+//  -v       keep VLDP's own console output
+
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include "vldp.h"
+#include "vldp_common.h"
+
+#define REPLAY_CHUNK 262144	// same as ivldp_render's BUFFER_SIZE
+
+static uint8_t replay_buf[REPLAY_CHUNK];
+static unsigned int replay_pos = 0;
+static unsigned int replay_len = 0;
+static uint32_t replay_code = 0xFFFFFFFF;	// last 4 bytes seen, for start codes split over chunks
+static bool replay_fresh = true;	// no picture has started since the stream was repositioned
+
+static double replay_now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static unsigned int replay_ticks()
+{
+	return (unsigned int) (replay_now() * 1000);
+}
+
+static void replay_progress(double) {}
+static void replay_blank() {}
+
+// the stream has been repositioned, anything buffered is stale
+static void replay_flush()
+{
+	replay_pos = replay_len = 0;
+	replay_code = 0xFFFFFFFF;
+	replay_fresh = true;
+}
+
+// reads until 'pictures' more pictures are complete (the start of the next picture, or the end of the stream,
+//  completes the current one)
+// returns how many were completed, fewer only if 'wrap' is off and the stream ended
+static unsigned int replay_pictures(unsigned int pictures, bool wrap)
+{
+	unsigned int done = 0;
+
+	if (!pictures) return 0;
+
+	for (;;) {
+		while (replay_pos < replay_len) {
+			replay_code = (replay_code << 8) | replay_buf[replay_pos++];
+			if (replay_code == 0x00000100) {
+				if (replay_fresh)
+					replay_fresh = false;
+				else if (++done == pictures)
+					return done;
+			}
+		}
+
+		replay_pos = 0;
+		replay_len = vldp_io_read(replay_buf, sizeof(replay_buf));
+		if (replay_len == 0) {
+			if (replay_fresh) return done;	// nothing left to read at all
+			if (++done == pictures || !wrap) return done;
+
+			// ivldp_render rewinds to the beginning at the end of the stream
+			vldp_io_seek(0);
+			replay_flush();
+		}
+	}
+}
+
+struct ReplayCmd {
+	unsigned int line;
+	uint32_t ms;
+	std::string cmd;
+	unsigned int arg;
+	double secs;
+	uint64_t bytes;
+	int discarded;
+	int hit;	// 1 hit, 0 miss, -1 didn't search
+};
+
+struct ReplayKind {
+	std::string cmd;
+	std::vector<double> secs;
+	uint64_t bytes = 0;
+	uint64_t discarded = 0;
+	unsigned int hits = 0;
+	unsigned int misses = 0;
+};
+
+static double replay_pct(std::vector<double> &v, double p)
+{
+	size_t i = (size_t) (p * (v.size() - 1) + 0.5);
+	return v[i];
+}
+
+int main(int argc, char **argv)
+{
+	const char *trace = NULL;
+	const char *dir = NULL;
+	const char *csv = NULL;
+	bool verbose = false;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-d") && i + 1 < argc) dir = argv[++i];
+		else if (!strcmp(argv[i], "-o") && i + 1 < argc) csv = argv[++i];
+		else if (!strcmp(argv[i], "-v")) verbose = true;
+		else if (argv[i][0] != '-' && !trace) trace = argv[i];
+		else trace = NULL, i = argc;
+	}
+	if (!trace) {
+		fprintf(stderr, "usage: %s [-d dir] [-o commands.csv] [-v] trace.txt\n", argv[0]);
+		return 1;
+	}
+
+	FILE *in = fopen(trace, "r");
+	if (!in) {
+		fprintf(stderr, "REPLAY : can't open %s\n", trace);
+		return 1;
+	}
+
+	static struct vldp_in_info info;
+	info.report_parse_progress = replay_progress;
+	info.render_blank_frame = replay_blank;
+	info.GetTicksFunc = replay_ticks;
+	unsetenv("VLDP_TRACE");	// don't record the replay, it could be the trace we're reading
+	vldp_init(&info);
+
+	// VLDP talks a lot on stdout, keep the report readable
+	int console = dup(1);
+	if (!verbose) {
+		fflush(stdout);
+		int null_fd = open("/dev/null", O_WRONLY);
+		dup2(null_fd, 1);
+		::close(null_fd);
+	}
+
+	std::vector<ReplayCmd> cmds;
+	bool playing = false;
+	unsigned int skip_per_frame = 0, stall_per_frame = 0;
+	uint32_t last_ms = 0;
+	double played_secs = 0;
+	uint64_t played_bytes = 0, played_pictures = 0;
+	unsigned int errors = 0;
+	char line[512];
+	unsigned int line_no = 0;
+	double start = replay_now();
+
+	while (fgets(line, sizeof(line), in)) {
+		char cmd[32], arg1[STRSIZE] = "", arg2[STRSIZE] = "";
+		uint32_t ms;
+		int args = 0, file = 0;
+
+		line_no++;
+		if (line[0] == '#' || line[0] == '\n') continue;
+		line[strcspn(line, "\r\n")] = 0;
+		int fields = sscanf(line, "%u %31s %n", &ms, cmd, &args);
+		if (fields < 2) {
+			fprintf(stderr, "REPLAY : %s:%u isn't a trace line\n", trace, line_no);
+			errors++;
+			continue;
+		}
+		// file names run to the end of the line and may hold spaces, openp has the index first
+		sscanf(line + args, "%319s %n%319s", arg1, &file, arg2);
+		if (!file) file = (int) strlen(line + args);
+
+		// the disc kept playing up to this command
+		if (playing && ms > last_ms && g_out_info.uFpks) {
+			uint64_t pictures = (uint64_t) (ms - last_ms) * g_out_info.uFpks * (skip_per_frame + 1) / (1000000ULL * (stall_per_frame + 1));
+			if (g_out_info.uses_fields) pictures <<= 1;
+
+			uint64_t bytes = g_out_info.u64BytesRead;
+			double t = replay_now();
+			played_pictures += replay_pictures((unsigned int) pictures, true);
+			played_secs += replay_now() - t;
+			played_bytes += g_out_info.u64BytesRead - bytes;
+		}
+		last_ms = ms;
+
+		ReplayCmd c = { line_no, ms, cmd, 0, 0, 0, 0, -1 };
+		uint64_t bytes = g_out_info.u64BytesRead;
+		unsigned int hits = g_out_info.uPrefetchHits;
+		double t = replay_now();
+
+		if (!strcmp(cmd, "open") || !strcmp(cmd, "openp") || !strcmp(cmd, "precache")) {
+			const char *name = line + args + (!strcmp(cmd, "openp") ? file : 0);
+			std::string path = name;
+			if (dir) {
+				const char *base = strrchr(name, '/');
+				path = std::string(dir) + "/" + (base ? base + 1 : name);
+			}
+			SAFE_STRCPY(g_req_file, path.c_str(), STRSIZE);
+
+			if (!strcmp(cmd, "precache"))
+				vldp_precache_req();
+			else {
+				g_req_precache = !strcmp(cmd, "openp");
+				g_req_idx = c.arg = atoi(arg1);
+				open();
+				replay_flush();
+				playing = false;
+			}
+			if (g_out_info.status != STAT_STOPPED) {
+				fprintf(stderr, "REPLAY : %s:%u %s %s failed\n", trace, line_no, cmd, path.c_str());
+				errors++;
+			}
+		}
+		else if (!strcmp(cmd, "search") || !strcmp(cmd, "skip")) {
+			bool skip = !strcmp(cmd, "skip");
+
+			g_req_frame = c.arg = atoi(arg1);
+			g_req_min_seek_ms = skip ? 0 : atoi(arg2);	// a real player waits this out, we don't
+			c.discarded = vldp_seek(skip);
+			if (c.discarded < 0) {
+				fprintf(stderr, "REPLAY : %s:%u %s %u is out of bounds\n", trace, line_no, cmd, c.arg);
+				errors++;
+				c.discarded = 0;
+			}
+			else {
+				c.hit = g_out_info.uPrefetchHits != hits;
+				replay_flush();
+				replay_pictures(c.discarded + 1, false);
+			}
+			playing = skip;
+		}
+		else if (!strcmp(cmd, "play"))
+			playing = true;
+		else if (!strcmp(cmd, "pause"))
+			playing = false;
+		else if (!strcmp(cmd, "step"))
+			replay_pictures(1, true);
+		else if (!strcmp(cmd, "speed")) {
+			skip_per_frame = atoi(arg1);
+			stall_per_frame = atoi(arg2);
+		}
+		else {
+			fprintf(stderr, "REPLAY : %s:%u unknown command %s\n", trace, line_no, cmd);
+			errors++;
+			continue;
+		}
+
+		c.secs = replay_now() - t;
+		c.bytes = g_out_info.u64BytesRead - bytes;
+		cmds.push_back(c);
+	}
+	fclose(in);
+	double total_secs = replay_now() - start;
+
+	fflush(stdout);
+	dup2(console, 1);
+	::close(console);
+
+	if (csv) {
+		FILE *out = fopen(csv, "w");
+		if (out) {
+			fprintf(out, "line,ms,command,arg,latency_us,bytes_read,frames_discarded,prefetch_hit\n");
+			for (const ReplayCmd &c : cmds)
+				fprintf(out, "%u,%u,%s,%u,%.1f,%llu,%d,%d\n", c.line, c.ms, c.cmd.c_str(), c.arg, c.secs * 1e6,
+					(unsigned long long) c.bytes, c.discarded, c.hit);
+			fclose(out);
+		}
+		else
+			fprintf(stderr, "REPLAY : can't create %s\n", csv);
+	}
+
+	std::vector<ReplayKind> kinds;
+	for (const ReplayCmd &c : cmds) {
+		auto k = std::find_if(kinds.begin(), kinds.end(), [&](const ReplayKind &k) { return k.cmd == c.cmd; });
+		if (k == kinds.end()) {
+			kinds.push_back(ReplayKind());
+			k = kinds.end() - 1;
+			k->cmd = c.cmd;
+		}
+		k->secs.push_back(c.secs);
+		k->bytes += c.bytes;
+		k->discarded += c.discarded;
+		if (c.hit == 1) k->hits++;
+		if (c.hit == 0) k->misses++;
+	}
+
+	printf("REPLAY - %s: %zu commands in %.3f s, %u errors\n", trace, cmds.size(), total_secs, errors);
+	printf("%-9s %6s %10s %10s %10s %10s %12s %10s %9s %9s\n", "command", "count", "min us", "med us", "p95 us", "max us",
+		"bytes read", "bytes/cmd", "discarded", "hit/miss");
+	for (ReplayKind &k : kinds) {
+		std::sort(k.secs.begin(), k.secs.end());
+		printf("%-9s %6zu %10.1f %10.1f %10.1f %10.1f %12llu %10llu %9llu %4u/%-4u\n", k.cmd.c_str(), k.secs.size(),
+			k.secs.front() * 1e6, replay_pct(k.secs, 0.5) * 1e6, replay_pct(k.secs, 0.95) * 1e6, k.secs.back() * 1e6,
+			(unsigned long long) k.bytes, (unsigned long long) (k.bytes / k.secs.size()), (unsigned long long) k.discarded,
+			k.hits, k.misses);
+	}
+	printf("%-9s %6s %10s %10s %10s %10.1f %12llu %10s %9llu pictures\n", "playback", "", "", "", "", played_secs * 1e6,
+		(unsigned long long) played_bytes, "", (unsigned long long) played_pictures);
+	printf("REPLAY - %llu bytes read in total, prefetch %u hits / %u misses\n", (unsigned long long) g_out_info.u64BytesRead,
+		g_out_info.uPrefetchHits, g_out_info.uPrefetchMisses);
+
+	vldp_precache_release();
+	return errors ? 1 : 0;
+}
@@ -28,6 +28,7 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "vldp.h"
 #include "vldp_common.h"
@@ -36,12 +37,16 @@
 
 int vldp_cmd(int cmd);
 int vldp_wait_for_status(int stat);
+static void vldp_trace_cmd(int cmd);
+VLDP_BOOL vldp_trace(const char *filename);
 
 //////////////////////////////////////////////////////////////////////////////////////
 
 //SDL_Thread *private_thread = NULL;
 
 int p_initialized = 0;	// whether VLDP has been initialized
+FILE *p_trace = NULL;	// seek trace we are recording commands into (if any)
+uint32_t p_trace_start = 0;	// timer value the trace's timestamps are relative to
 
 uint8_t g_req_cmdORcount = CMDORCOUNT_INITIAL;	// the current command parent thread requests of the child thread
 unsigned int g_ack_count = ACK_COUNT_INITIAL;	// the result returned by the internal child thread
@@ -69,6 +74,9 @@ int vldp_cmd(int cmd)
 	uint8_t tmp = g_req_cmdORcount;	// we want to replace the real value atomically so we use a tmp variable first
 	static unsigned int old_ack_count = ACK_COUNT_INITIAL;
 
+	if (p_trace)
+		vldp_trace_cmd(cmd);
+
 	tmp++;	// increment the counter so child thread knows we're issuing a new command
 	tmp &= 0xF;	// strip off old command
 	tmp |= cmd;	// replace it with new command
@@ -94,6 +102,45 @@ int vldp_cmd(int cmd)
 	return result;
 }
 
+// writes the command that's about to be issued (and its g_req_* arguments) to the seek trace
+static void vldp_trace_cmd(int cmd)
+{
+	uint32_t ms = g_in_info->GetTicksFunc() - p_trace_start;
+
+	switch (cmd)
+	{
+	case VLDP_REQ_OPEN:
+		if (g_req_precache)
+			fprintf(p_trace, "%u openp %u %s\n", ms, g_req_idx, g_req_file);
+		else
+			fprintf(p_trace, "%u open %s\n", ms, g_req_file);
+		break;
+	case VLDP_REQ_PRECACHE:
+		fprintf(p_trace, "%u precache %s\n", ms, g_req_file);
+		break;
+	case VLDP_REQ_SEARCH:
+		fprintf(p_trace, "%u search %u %u\n", ms, g_req_frame, g_req_min_seek_ms);
+		break;
+	case VLDP_REQ_SKIP:
+		fprintf(p_trace, "%u skip %u\n", ms, g_req_frame);
+		break;
+	case VLDP_REQ_PLAY:
+		fprintf(p_trace, "%u play %u\n", ms, g_req_timer);
+		break;
+	case VLDP_REQ_PAUSE:
+		fprintf(p_trace, "%u pause\n", ms);
+		break;
+	case VLDP_REQ_STEP_FORWARD:
+		fprintf(p_trace, "%u step\n", ms);
+		break;
+	case VLDP_REQ_SPEEDCHANGE:
+		fprintf(p_trace, "%u speed %u %u\n", ms, g_req_skip_per_frame, g_req_stall_per_frame);
+		break;
+	default:	// lock, unlock and quit don't affect what gets read
+		break;
+	}
+}
+
 // waits until the disc status is 'stat'
 // if the stat we want is received, return 1 (success)
 // if we time out, or if we get an error stat, return 0 (error)
@@ -140,6 +187,31 @@ void vldp_shutdown()
 //		SDL_WaitThread(private_thread, NULL);	// wait for private thread to terminate
 	}
 	p_initialized = 0;
+
+	vldp_trace(NULL);
+}
+
+VLDP_BOOL vldp_trace(const char *filename)
+{
+	if (p_trace)
+	{
+		fclose(p_trace);
+		p_trace = NULL;
+	}
+
+	if (filename)
+	{
+		p_trace = fopen(filename, "w");
+		if (!p_trace)
+		{
+			fprintf(stderr, "VLDP ERROR : can't create seek trace %s\n", filename);
+			return VLDP_FALSE;
+		}
+		fprintf(p_trace, "# vldp seek trace 1\n");
+		p_trace_start = g_in_info->GetTicksFunc();
+	}
+
+	return VLDP_TRUE;
 }
 
 // requests that we open an mpeg file
@@ -332,6 +404,11 @@ const struct vldp_out_info *vldp_init(const struct vldp_in_info *in_info)
 	g_out_info.speedchange = vldp_speedchange;
 	g_out_info.lock = vldp_lock;
 	g_out_info.unlock = vldp_unlock;
+	g_out_info.trace = vldp_trace;
+
+	// VLDP_TRACE=<file> records the whole session from here on, whichever player is driving VLDP
+	const char *trace_file = getenv("VLDP_TRACE");
+	if (trace_file && *trace_file) vldp_trace(trace_file);
 
 	// RJS CHANGE - new parm for SDL2
 //	private_thread = SDL_CreateThread(idle_handler, "PRIVATE", NULL);	// start our internal thread
@@ -136,6 +136,12 @@ struct vldp_out_info
 	
 	// Unlocks a previous lock operation. Returns true if unlock was successful, or false if we timed out.
 	VLDP_BOOL (*unlock)(unsigned int uTimeoutMs);
+
+	// Starts recording every command issued through this API into a seek trace (one "<ms> <command> <args>" line
+	//  per command, see vldp_replay), or stops recording if filename is NULL.
+	// vldp_init() starts one by itself if the VLDP_TRACE environment variable names a file.
+	// Returns VLDP_FALSE if the trace file couldn't be created.
+	VLDP_BOOL (*trace)(const char *filename);
 	
 	////////////////////////////////////////////////////////////
 
@@ -148,6 +154,9 @@ struct vldp_out_info
 	int status;	// the current status of the VLDP (see STAT_ enum's)
 	unsigned int current_frame;	// the current frame of the opened mpeg that we are on
 	unsigned int uLastCachedIndex;	// the index of the file that was last precached (if any)
+	unsigned int uPrefetchHits;	// how many searches were served from the seek target prefetch
+	unsigned int uPrefetchMisses;	// how many searches had to go to the file
+	uint64_t u64BytesRead;	// how many bytes have been read from the mpeg file (prefetch hits don't count)
 };
 
 enum
@@ -69,6 +69,15 @@ extern unsigned int g_req_stall_per_frame;	// how many frames to stall per frame
 
 void open();
 void search();
+int vldp_seek(int skip);
+void vldp_precache_req();
+void vldp_precache_release();
+unsigned int vldp_load_frame_offsets(const char *filename);
+uint32_t vldp_seek_position(uint16_t frame, int *frames_to_skip);
+
+// VLDP's io layer (vldp_internal.c), for the parser and the tools that stand in for the decoder
+unsigned int vldp_io_read(void *buf, unsigned int uBytesToRead);
+int vldp_io_seek(unsigned int uPos);	// VLDP_TRUE on success
 
 // how ms to wait for responses from the private thread before we give up and return an error
 // NOTE : increased from 5000 now that artificial seek delay functionality is added
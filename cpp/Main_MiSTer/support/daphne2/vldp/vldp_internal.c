@@ -49,6 +49,8 @@ static void ivldp_lock_handler(void);
 static void ivldp_respond_req_play(void);
 static void ivldp_render(void);
 static void idle_handler_search(int skip);
+static uint32_t ivldp_find_seek_position(unsigned int uAdjustedReqFrame, int *pFramesToSkip, int *pSkippedI);
+static VLDP_BOOL ivldp_search_seek(uint16_t req_frame, int skip);
 static void idle_handler_open(void);
 static void idle_handler_precache(void);
 static void idle_handler_play(void);
@@ -60,9 +62,11 @@ static VLDP_BOOL io_open_precached(unsigned int uIdx);
 static VLDP_BOOL io_open(const char *cpszFilename);
 static VLDP_BOOL io_is_open(void);
 static unsigned int io_length(void);
-static VLDP_BOOL io_seek(unsigned int uPos);
-static unsigned int io_read(void *buf, unsigned int uBytesToRead);
 static void io_close(void);
+static void prefetch_reset(const char *cpszFilename);
+static unsigned int prefetch_learn(uint32_t uPos);
+static void prefetch_fill(uint32_t uPos, unsigned int uHits);
+static VLDP_BOOL prefetch_seek(uint32_t uPos);
 static void ivldp_respond_req_speedchange(void);
 static void ivldp_respond_req_pause_or_step(void);
 
@@ -368,6 +372,34 @@ static uint8_t g_buffer[BUFFER_SIZE];	// buffer to hold mpeg2 file as we read it
 static uint8_t g_header_buf[HEADER_BUF_SIZE];
 static unsigned int g_header_buf_size = 0;	// size of the header buffer
 
+// Seek target prefetch.  Games only ever search to a small set of scene starts, so we learn which
+//  I frame offsets searches land on and keep the beginning of the hottest ones in memory.
+#define PREFETCH_TARGETS 256	// how many distinct seek targets we keep statistics for
+#define PREFETCH_SLOTS 16	// how many seek targets we keep resident
+#define PREFETCH_BYTES 65536	// how much of the stream we keep after each resident target
+#define PREFETCH_EMPTY 0xFFFFFFFF
+
+struct prefetch_target_s
+{
+	uint32_t uPos;	// file offset that searches land on
+	unsigned int uHits;	// how many times we've searched there
+};
+
+struct prefetch_slot_s
+{
+	uint32_t uPos;	// file offset the slot holds data for (PREFETCH_EMPTY if unused)
+	unsigned int uHits;	// hit count of the target when it was last used (picks the slot to evict)
+	unsigned int uLength;	// how many bytes of buf are valid
+	uint8_t buf[PREFETCH_BYTES];
+};
+
+static struct prefetch_target_s s_prefetch_targets[PREFETCH_TARGETS];
+static unsigned int s_prefetch_target_count = 0;
+static struct prefetch_slot_s s_prefetch_slots[PREFETCH_SLOTS];
+static struct prefetch_slot_s *s_prefetch_cur = NULL;	// slot that vldp_io_read is currently serving from
+static unsigned int s_prefetch_cur_pos = 0;	// our position within s_prefetch_cur
+static char s_prefetch_file[STRSIZE] = { 0 };	// file that the statistics were learned from
+
 // how many frames we will stall after beginning playback (should be 1, because presumably before we start playing,
 //  the disc has been paused showing the same frame, and we want the frame to display 1 more frame before moving
 //  to the next one.  This behavior is somewhat arbitrary to act like we think laserdisc players act, but this
@@ -387,6 +419,58 @@ void search()
     idle_handler_search(0);
 }
 
+// does everything a search (or skip) to g_req_frame does except decoding, leaving the stream on the I frame
+// returns how many frames have to be decoded and discarded before g_req_frame is reached, or -1 on error
+int vldp_seek(int skip)
+{
+	vldp_process_sequence_header();
+	if (!ivldp_search_seek(g_req_frame, skip)) return -1;
+	return s_frames_to_skip;
+}
+
+// precaches g_req_file, what the vldp_precache() API call in vldp.c asks the VLDP thread to do
+void vldp_precache_req()
+{
+	idle_handler_precache();
+}
+
+// frees every precached file, the same as VLDP does when it quits
+void vldp_precache_release()
+{
+	while (s_uPreCacheIdxCount > 0)
+	{
+		--s_uPreCacheIdxCount;
+		free(s_sPreCacheEntries[s_uPreCacheIdxCount].ptrBuf);
+	}
+}
+
+// reloads (or parses) the frame offsets of the file that is already open
+// returns how many frames were loaded, or 0 on error
+unsigned int vldp_load_frame_offsets(const char *filename)
+{
+	char req_file[STRSIZE] = { 0 };
+
+	if (!io_is_open()) return 0;
+
+	SAFE_STRCPY(req_file, filename, sizeof(req_file));
+	vldp_io_seek(0);	// the parser starts from the beginning
+	if (!ivldp_get_mpeg_frame_offsets(req_file)) return 0;
+	return g_totalframes;
+}
+
+// where a search to 'frame' of the open file would start decoding, without doing the search
+uint32_t vldp_seek_position(uint16_t frame, int *frames_to_skip)
+{
+	int skipped_I = 0;
+	unsigned int uAdjustedReqFrame = frame;
+
+	if (g_out_info.uses_fields) uAdjustedReqFrame <<= 1;
+	*frames_to_skip = 0;
+	if (uAdjustedReqFrame >= g_totalframes) return 0xFFFFFFFF;
+
+	return ivldp_find_seek_position(uAdjustedReqFrame, frames_to_skip, &skipped_I);
+}
+
 ////////////////////////////////////////////////
 
 // this is our video thread which gets called
@@ -413,6 +497,13 @@ void idle_handler()
 				done = 1;
                 io_close();
 
+				if (g_out_info.uPrefetchHits + g_out_info.uPrefetchMisses)
+				{
+					printf("VLDP prefetch : %u hits, %u misses (%u%% hit rate)\n",
+						g_out_info.uPrefetchHits, g_out_info.uPrefetchMisses,
+						(g_out_info.uPrefetchHits * 100) / (g_out_info.uPrefetchHits + g_out_info.uPrefetchMisses));
+				}
+
                 g_out_info.status = STAT_ERROR;
 //            mpeg2_close(g_mpeg_data);	// shutdown libmpeg2
                 vo_null_close();		// shutdown null driver
@@ -700,8 +791,8 @@ void vldp_cache_sequence_header()
 	uint32_t val = 0;
 	unsigned int index = 0;
 
-	io_seek(0);	// start at beginning
-	io_read(g_header_buf, HEADER_BUF_SIZE); // assume that we must find the first frame in this chunk of bytes
+	vldp_io_seek(0);	// start at beginning
+	vldp_io_read(g_header_buf, HEADER_BUF_SIZE); // assume that we must find the first frame in this chunk of bytes
 		// if not, we'll have to increase the number
 
 	// go until we have found the first frame or we run out of data
@@ -780,7 +871,7 @@ static void idle_handler_open()
 	if (bSuccess)
 	{
 		uint8_t small_buf[8];
-		io_read(small_buf, sizeof(small_buf));	// 1st 8 bytes reveal much
+		vldp_io_read(small_buf, sizeof(small_buf));	// 1st 8 bytes reveal much
 		
 		// if we find the proper mpeg2 video header at the beginning of the file
 		if (((small_buf[0] << 24) | (small_buf[1] << 16) | (small_buf[2] << 8) | small_buf[3]) == 0x000001B3)
@@ -789,7 +880,7 @@ static void idle_handler_open()
 			g_out_info.h = ((small_buf[5] & 0x0F) << 8) | small_buf[6];	// get mpeg height
 			ivldp_set_framerate(small_buf[7] & 0xF);	// set the framerate
 
-			io_seek(0);	// go back to beginning for parser's benefit
+			vldp_io_seek(0);	// go back to beginning for parser's benefit
 
 			// load/parse all the frame locations in the file for super fast seeking
 			if (ivldp_get_mpeg_frame_offsets(req_file))
@@ -800,7 +891,11 @@ static void idle_handler_open()
                 // TODO dentnz - this header is needed for proper mpeg2 decoding
 				vldp_cache_sequence_header();	// cache sequence header for faster seeking
 
-				io_seek(0);	// seek back to beginning of file
+				// every framefile segment starts at frame 0 of its file, so that's always a likely search target
+				if (!req_precache && (g_frame_position[0] != PREFETCH_EMPTY))
+					prefetch_fill(g_frame_position[0], prefetch_learn(g_frame_position[0]));
+
+				vldp_io_seek(0);	// seek back to beginning of file
                 printf("got the file to open, and offsets loaded too. Stopping\n");
 				g_out_info.status = STAT_STOPPED;	// now that the file is open, we're ready to play
 			}
@@ -985,7 +1080,7 @@ static void ivldp_render(void)
    while (!render_finished)
    {
       //		end = g_buffer + fread (g_buffer, 1, BUFFER_SIZE, g_mpeg_handle);
-      end = g_buffer + io_read(g_buffer, BUFFER_SIZE);
+      end = g_buffer + vldp_io_read(g_buffer, BUFFER_SIZE);
 
       // safety check, they could be equal if we were already at EOF before we tried this
       // read chunk of video stream
@@ -1000,7 +1095,7 @@ static void ivldp_render(void)
 
          // reset libmpeg2 so it is prepared to begin reading from the beginning of the file
 //         mpeg2_reset(g_mpeg_data,0);
-         io_seek(0);	// seek to the beginning of the file
+         vldp_io_seek(0);	// seek to the beginning of the file
          g_out_info.current_frame = 0;	// set frame # to beginning of file where it belongs
       }
 
@@ -1031,16 +1126,9 @@ static void ivldp_render(void)
 // and not adjust any timers)
 static void idle_handler_search(int skip)
 {
-	uint32_t proposed_pos = 0;
 	uint16_t req_frame = g_req_frame; // after we acknowledge the command, g_req_frame could become clobbered
 	uint32_t min_seek_ms = g_req_min_seek_ms;	// g_req_min_seek_ms can be clobbered at any time after we acknowledge command
 
-	// adjusted req frame is the requested frame with fields taken into account
-	unsigned int uAdjustedReqFrame = 0;
-
-	unsigned int actual_frame = 0;
-	int skipped_I = 0;
-
 	// status must be changed before acknowledging command, because previous status could be STAT_ERROR, which
 	//  causes problems with *_and_block vldp API commands.
 	if (!skip)
@@ -1106,51 +1194,34 @@ static void idle_handler_search(int skip)
 			g_in_info->render_blank_frame();
 	}
 
+	// position the stream on the I frame the search has to start decoding from, then decode up to the frame we want
+	if (ivldp_search_seek(req_frame, skip))
+		ivldp_render();
+}
+
+// positions the stream for a search or skip to req_frame and sets up how many frames have to be discarded before it
+// returns VLDP_FALSE (and sets STAT_ERROR) if req_frame is out of bounds
+static VLDP_BOOL ivldp_search_seek(uint16_t req_frame, int skip)
+{
+	uint32_t proposed_pos = 0;
+	int skipped_I = 0;
+
 	// adjusted req frame is the requested frame with fields taken into account
-	uAdjustedReqFrame = req_frame;
+	unsigned int uAdjustedReqFrame = req_frame;
 
 	// if we're using fields, then the requested frame must be doubled (2 fields per frame)
 	if (g_out_info.uses_fields) uAdjustedReqFrame <<= 1;
 
-	actual_frame = uAdjustedReqFrame;
-
 	// do a bounds check
 	if (uAdjustedReqFrame < g_totalframes)
 	{
-		proposed_pos = g_frame_position[uAdjustedReqFrame];	// get the proposed position
-
 		s_frames_to_skip = s_frames_to_skip_with_inc = 0;	// the below problem is no longer a problem
-
-		// loop until we find which position in the file to seek to
-		for (;;)
-      {
-         // if the frame we want is not an I frame, go backward until we find an I frame, and increase # of frames to skip forward
-         while ((proposed_pos == 0xFFFFFFFF) && (actual_frame > 0))
-         {
-            s_frames_to_skip++;
-            actual_frame--;
-            proposed_pos = g_frame_position[actual_frame];
-         }
-         skipped_I++;
-
-         // if we are only 2 frames away from an I frame, we will get a corrupted image and need to go back to
-         // the I frame before this one
-         if ((skipped_I < 2) && (s_frames_to_skip < 3) && (actual_frame > 0))
-            proposed_pos = 0xFFFFFFFF;
-         else
-         {
-            printf("We've decided on a position within the file.\n");
-            printf("skipped_I is %d\n", skipped_I);
-            printf("s_frames_to_skip is %d\n", s_frames_to_skip);
-            printf("actual_frame is %d\n", actual_frame);
-            break;
-         }
-      }
+		proposed_pos = ivldp_find_seek_position(uAdjustedReqFrame, &s_frames_to_skip, &skipped_I);
 
 		printf("frames_to_skip is %d, skipped_I is %d\n", s_frames_to_skip, skipped_I);
 		printf("position in mpeg2 stream we are seeking to : %x\n", proposed_pos);
 
-		io_seek(proposed_pos);
+		prefetch_seek(proposed_pos);
 //		fseek(g_mpeg_handle, proposed_pos, SEEK_SET);	// go to the place in the stream where the I frame begins
 
 		// if we're seeking, we can change the frame right now ...
@@ -1165,14 +1236,44 @@ static void idle_handler_search(int skip)
 			s_uPendingSkipFrame = req_frame;
 
 		s_blanked = 0;	// we want to see the frame
-
-		ivldp_render();
+		return VLDP_TRUE;
 	} // end if the bounds check passed
 	else
 	{
 		fprintf(stderr, "SEARCH ERROR : frame %u was requested, but it is out of bounds\n", req_frame);
 		g_out_info.status = STAT_ERROR;
 	}
+	return VLDP_FALSE;
+}
+
+// picks the I frame a search to uAdjustedReqFrame has to start decoding from
+// (uAdjustedReqFrame must be in bounds, and already doubled if the stream uses fields)
+static uint32_t ivldp_find_seek_position(unsigned int uAdjustedReqFrame, int *pFramesToSkip, int *pSkippedI)
+{
+	uint32_t proposed_pos = g_frame_position[uAdjustedReqFrame];	// get the proposed position
+	unsigned int actual_frame = uAdjustedReqFrame;
+
+	// loop until we find which position in the file to seek to
+	for (;;)
+	{
+		// if the frame we want is not an I frame, go backward until we find an I frame, and increase # of frames to skip forward
+		while ((proposed_pos == 0xFFFFFFFF) && (actual_frame > 0))
+		{
+			(*pFramesToSkip)++;
+			actual_frame--;
+			proposed_pos = g_frame_position[actual_frame];
+		}
+		(*pSkippedI)++;
+
+		// if we are only 2 frames away from an I frame, we will get a corrupted image and need to go back to
+		// the I frame before this one
+		if ((*pSkippedI < 2) && (*pFramesToSkip < 3) && (actual_frame > 0))
+			proposed_pos = 0xFFFFFFFF;
+		else
+			break;
+	}
+
+	return proposed_pos;
 }
 
 // parses an mpeg video stream to get its frame offsets, or if the parsing had taken place earlier
@@ -1361,7 +1462,12 @@ static VLDP_BOOL io_open(const char *cpszFilename)
 	{
 		g_mpeg_handle = fopen(cpszFilename, "rb");
 		if (g_mpeg_handle)
-         return VLDP_TRUE;
+		{
+			// what we learned about search targets only applies to the file it was learned from
+			if (strcmp(s_prefetch_file, cpszFilename) != 0)
+				prefetch_reset(cpszFilename);
+			return VLDP_TRUE;
+		}
 	}
 	return VLDP_FALSE;
 }
@@ -1384,13 +1490,34 @@ static VLDP_BOOL io_open_precached(unsigned int uIdx)
 	return VLDP_FALSE;	
 }
 
-static unsigned int io_read(void *buf, unsigned int uBytesToRead)
+unsigned int vldp_io_read(void *buf, unsigned int uBytesToRead)
 {
 	unsigned int uBytesRead = 0;
 
 	// if we're reading from a file stream
 	if (g_mpeg_handle)
-		uBytesRead = (unsigned int) fread(buf, 1, uBytesToRead, g_mpeg_handle);
+	{
+		// if we just searched to a resident target, the first part comes from memory
+		if (s_prefetch_cur)
+		{
+			uBytesRead = s_prefetch_cur->uLength - s_prefetch_cur_pos;
+			if (uBytesRead > uBytesToRead)
+				uBytesRead = uBytesToRead;
+
+			memcpy(buf, s_prefetch_cur->buf + s_prefetch_cur_pos, uBytesRead);
+			s_prefetch_cur_pos += uBytesRead;
+
+			// the file is already positioned right after the prefetched data
+			if (s_prefetch_cur_pos >= s_prefetch_cur->uLength)
+				s_prefetch_cur = NULL;
+		}
+
+		{
+			unsigned int uFromFile = (unsigned int) fread(((unsigned char *) buf) + uBytesRead, 1, uBytesToRead - uBytesRead, g_mpeg_handle);
+			g_out_info.u64BytesRead += uFromFile;
+			uBytesRead += uFromFile;
+		}
+	}
 	else
 	{
       // else we're reading from a precache stream
@@ -1409,8 +1536,10 @@ static unsigned int io_read(void *buf, unsigned int uBytesToRead)
 	return uBytesRead;
 }
 
-VLDP_BOOL io_seek(unsigned int uPos)
+VLDP_BOOL vldp_io_seek(unsigned int uPos)
 {
+	s_prefetch_cur = NULL;
+
 	if (g_mpeg_handle)
 	{
 		if (fseek(g_mpeg_handle, uPos, SEEK_SET) == 0)
@@ -1432,6 +1561,8 @@ VLDP_BOOL io_seek(unsigned int uPos)
 
 static void io_close(void)
 {
+	s_prefetch_cur = NULL;
+
 	if (g_mpeg_handle)
 	{
 		fclose(g_mpeg_handle);
@@ -1463,3 +1594,117 @@ static unsigned int io_length(void)
 
 	return 0;
 }
+
+// forgets all learned seek targets and resident data
+static void prefetch_reset(const char *cpszFilename)
+{
+	unsigned int u = 0;
+
+	SAFE_STRCPY(s_prefetch_file, cpszFilename, sizeof(s_prefetch_file));
+	s_prefetch_target_count = 0;
+	s_prefetch_cur = NULL;
+
+	for (u = 0; u < PREFETCH_SLOTS; u++)
+	{
+		s_prefetch_slots[u].uPos = PREFETCH_EMPTY;
+		s_prefetch_slots[u].uHits = 0;
+		s_prefetch_slots[u].uLength = 0;
+	}
+}
+
+// records a search landing on uPos and returns how many times we've landed there so far
+static unsigned int prefetch_learn(uint32_t uPos)
+{
+	unsigned int u = 0;
+	struct prefetch_target_s *coldest = NULL;
+
+	for (u = 0; u < s_prefetch_target_count; u++)
+	{
+		if (s_prefetch_targets[u].uPos == uPos)
+			return ++s_prefetch_targets[u].uHits;
+		if ((!coldest) || (s_prefetch_targets[u].uHits < coldest->uHits))
+			coldest = &s_prefetch_targets[u];
+	}
+
+	// new target, take a free entry or replace the one we've seen the least
+	if (s_prefetch_target_count < PREFETCH_TARGETS)
+		coldest = &s_prefetch_targets[s_prefetch_target_count++];
+
+	coldest->uPos = uPos;
+	coldest->uHits = 1;
+	return 1;
+}
+
+// reads the data after uPos into a slot if the target is at least as hot as the coldest resident one
+// (leaves the file positioned right after whatever was read)
+static void prefetch_fill(uint32_t uPos, unsigned int uHits)
+{
+	unsigned int u = 0;
+	struct prefetch_slot_s *victim = &s_prefetch_slots[0];
+
+	for (u = 1; u < PREFETCH_SLOTS; u++)
+	{
+		if (s_prefetch_slots[u].uHits < victim->uHits)
+			victim = &s_prefetch_slots[u];
+	}
+
+	s_prefetch_cur = NULL;
+	if (victim->uHits > uHits)
+		return;
+
+	if (fseek(g_mpeg_handle, uPos, SEEK_SET) == 0)
+	{
+		victim->uPos = uPos;
+		victim->uHits = uHits;
+		victim->uLength = (unsigned int) fread(victim->buf, 1, PREFETCH_BYTES, g_mpeg_handle);
+		g_out_info.u64BytesRead += victim->uLength;
+		s_prefetch_cur = victim;
+		s_prefetch_cur_pos = 0;
+	}
+	else
+	{
+		victim->uPos = PREFETCH_EMPTY;
+		victim->uHits = 0;
+	}
+}
+
+// like vldp_io_seek but for search targets, so that the first read after it can be served from memory
+static VLDP_BOOL prefetch_seek(uint32_t uPos)
+{
+	unsigned int u = 0;
+	unsigned int uHits = 0;
+
+	// precached files are in memory already
+	if (!g_mpeg_handle)
+		return vldp_io_seek(uPos);
+
+	uHits = prefetch_learn(uPos);
+
+	for (u = 0; u < PREFETCH_SLOTS; u++)
+	{
+		struct prefetch_slot_s *slot = &s_prefetch_slots[u];
+
+		if (slot->uPos == uPos)
+		{
+			g_out_info.uPrefetchHits++;
+			slot->uHits = uHits;
+
+			// keep the file in step so reading carries on seamlessly once the slot is used up
+			if (fseek(g_mpeg_handle, uPos + slot->uLength, SEEK_SET) != 0)
+				return vldp_io_seek(uPos);
+
+			s_prefetch_cur = slot;
+			s_prefetch_cur_pos = 0;
+			return VLDP_TRUE;
+		}
+	}
+
+	g_out_info.uPrefetchMisses++;
+
+	// we have to read this part of the stream anyway, so keep it if the target is worth it
+	prefetch_fill(uPos, uHits);
+	if (s_prefetch_cur)
+		return VLDP_TRUE;
+
+	return vldp_io_seek(uPos);
+}
@@ -0,0 +1,503 @@
+#include "../file_io.h"
+#include "daphne_lib.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <vector>
+
+////////////// Game library ///////////////
+
+#define HEADER_BUF_SIZE 200
+#define SCAN_CHUNK      (256 * 1024)
+#define READAHEAD_SIZE  (64 * 1024)  // per m2v, seeks land on I frames and stream on from there
+
+// header of the .dat index files, must stay binary compatible with VLDP's struct dat_header
+struct dat_header
+{
+	uint8_t  version;
+	uint8_t  finished;
+	uint8_t  uses_fields;
+	uint32_t length;
+};
+
+struct daphne_file
+{
+	fileTYPE              f;
+	char                  path[1024];
+	uint8_t               uses_fields;
+	uint8_t               header[HEADER_BUF_SIZE];  // everything before the first GOP
+	int                   header_size;
+	std::vector<uint32_t> index;                    // offset of every I frame, DAPHNE_NO_IFRAME otherwise
+};
+
+struct daphne_segment
+{
+	int32_t frame;  // laserdisc frame the segment starts on
+	int     file;   // index into files[]
+};
+
+static daphne_segment segments[DAPHNE_MAX_SEGMENTS];
+static daphne_file   *files[DAPHNE_MAX_SEGMENTS] = {};
+static int segment_count = 0;
+static int file_count = 0;
+
+// stream position
+static int cur_segment = -1;
+static const uint8_t *pending_header = 0;
+static int pending_size = 0;
+
+static uint8_t scanbuf[SCAN_CHUNK];
+
+enum { SCAN_NONE, SCAN_PIC, SCAN_EXT };
+
+// Same walk as VLDP's mpegscan: record the offset of each I frame picture header
+// and work out whether the stream is coded as fields or frames.
+static int build_index(daphne_file *df, const char *dat_path)
+{
+	uint32_t window = 0xFFFFFFFF;
+	uint32_t pic_pos = 0;
+	uint8_t ext_type = 0;
+	int state = SCAN_NONE;
+	int rel = 0;
+	int fields = 0, frames = 0;
+	__off64_t pos = 0;
+	int len;
+
+	printf("Daphne: building index for %s\n", df->path);
+
+	df->index.clear();
+	FileSeek(&df->f, 0, SEEK_SET);
+	while ((len = FileReadAdv(&df->f, scanbuf, sizeof(scanbuf))) > 0)
+	{
+		for (int i = 0; i < len; i++, pos++)
+		{
+			uint8_t ch = scanbuf[i];
+
+			if (state == SCAN_PIC)
+			{
+				// picture_coding_type sits in the second byte after the start code
+				if (rel++ == 1)
+				{
+					df->index.push_back((((ch >> 3) & 7) == 1) ? pic_pos : DAPHNE_NO_IFRAME);
+					state = SCAN_NONE;
+				}
+			}
+			else if (state == SCAN_EXT)
+			{
+				if (rel == 0) ext_type = ch >> 4;
+				else if (rel == 2)
+				{
+					// picture_coding_extension: 1/2 = top/bottom field, 3 = frame
+					if (ext_type == 8)
+					{
+						if ((ch & 3) == 1 || (ch & 3) == 2) fields = 1;
+						else if ((ch & 3) == 3) frames = 1;
+					}
+					state = SCAN_NONE;
+				}
+				rel++;
+			}
+			else if ((window & 0xFFFFFF) == 0x000001)
+			{
+				if (ch == 0x00)
+				{
+					state = SCAN_PIC;
+					rel = 0;
+					pic_pos = (uint32_t)(pos - 3);
+				}
+				else if (ch == 0xB5)
+				{
+					state = SCAN_EXT;
+					rel = 0;
+				}
+			}
+
+			window = (window << 8) | ch;
+		}
+	}
+
+	if (fields && frames)
+	{
+		printf("Daphne: %s mixes fields and frames, cannot index it.\n", df->path);
+		df->index.clear();
+		return 0;
+	}
+	df->uses_fields = fields;
+
+	FILE *F = fopen(dat_path, "wb");
+	if (F)
+	{
+		dat_header header = {};
+		header.version = DAPHNE_DAT_VERSION;
+		header.finished = 1;
+		header.uses_fields = df->uses_fields;
+		header.length = (uint32_t)df->f.size;
+		fwrite(&header, sizeof(header), 1, F);
+		fwrite(df->index.data(), sizeof(uint32_t), df->index.size(), F);
+		fclose(F);
+	}
+	else
+	{
+		// the in-memory index is still good, it just has to be rebuilt next time
+		printf("Daphne: could not write %s\n", dat_path);
+	}
+
+	return 1;
+}
+
+static int load_index(daphne_file *df)
+{
+	char dat_path[1024];
+	int len = strlen(df->path);
+	if (len < 3) return 0;
+
+	strcpy(dat_path, df->path);
+	strcpy(dat_path + len - 3, "dat");
+
+	FILE *F = fopen(dat_path, "rb");
+	if (F)
+	{
+		dat_header header;
+		int valid = (fread(&header, sizeof(header), 1, F) == 1) &&
+			(header.version == DAPHNE_DAT_VERSION) && (header.finished == 1) &&
+			(header.length == (uint32_t)df->f.size);
+
+		if (valid)
+		{
+			fseeko64(F, 0, SEEK_END);
+			size_t entries = (ftello64(F) - sizeof(header)) / sizeof(uint32_t);
+			fseeko64(F, sizeof(header), SEEK_SET);
+
+			df->uses_fields = header.uses_fields;
+			df->index.resize(entries);
+			valid = (fread(df->index.data(), sizeof(uint32_t), entries, F) == entries);
+		}
+		fclose(F);
+
+		if (valid) return 1;
+		printf("Daphne: %s is stale.\n", dat_path);
+	}
+
+	return build_index(df, dat_path);
+}
+
+// keep the sequence header so a seek into the middle of the file can be decoded
+static void cache_header(daphne_file *df)
+{
+	uint32_t val = 0;
+
+	df->header_size = 0;
+	FileSeek(&df->f, 0, SEEK_SET);
+	int len = FileReadAdv(&df->f, df->header, sizeof(df->header));
+
+	for (int i = 0; i < len; i++)
+	{
+		val = (val << 8) | df->header[i];
+		if (val == 0x000001B8)
+		{
+			df->header_size = i - 3;
+			return;
+		}
+	}
+
+	printf("Daphne: no GOP in the first %d bytes of %s\n", len, df->path);
+}
+
+static int add_file(const char *path)
+{
+	for (int i = 0; i < file_count; i++)
+	{
+		if (!strcmp(files[i]->path, path)) return i;
+	}
+
+	daphne_file *df = new daphne_file;
+	snprintf(df->path, sizeof(df->path), "%s", path);
+	df->uses_fields = 0;
+	df->header_size = 0;
+
+	if (!FileOpen(&df->f, df->path) || !FileSetReadahead(&df->f, READAHEAD_SIZE) || !load_index(df))
+	{
+		delete df;
+		return -1;
+	}
+	cache_header(df);
+
+	files[file_count] = df;
+	return file_count++;
+}
+
+static char *trim(char *str)
+{
+	while (isspace((unsigned char)*str)) str++;
+	char *end = str + strlen(str);
+	while (end > str && isspace((unsigned char)end[-1])) *--end = 0;
+	return str;
+}
+
+// Framefile format: first line is the mpeg directory (relative to the framefile
+// unless absolute), followed by "<laserdisc frame> <m2v name>" lines.
+static int parse_framefile(char *buf, const char *framefile)
+{
+	char mpeg_path[1024];
+	char seg_path[2048];
+	int line_number = 1;
+
+	char *line = strsep(&buf, "\n");
+	char *dir = trim(line);
+	if (!buf || !*dir)
+	{
+		printf("Daphne: framefile %s must have at least 2 lines.\n", framefile);
+		return 0;
+	}
+
+	if (dir[0] != '/' && dir[0] != '\\' && dir[1] != ':')
+	{
+		const char *p = strrchr(framefile, '/');
+		snprintf(mpeg_path, sizeof(mpeg_path), "%.*s%s", p ? (int)(p - framefile + 1) : 0, framefile, dir);
+	}
+	else
+	{
+		snprintf(mpeg_path, sizeof(mpeg_path), "%s", dir);
+	}
+
+	for (char *p = mpeg_path; *p; p++) if (*p == '\\') *p = '/';
+	if (mpeg_path[strlen(mpeg_path) - 1] != '/') strcat(mpeg_path, "/");
+
+	while ((line = strsep(&buf, "\n")))
+	{
+		line_number++;
+
+		char *p = trim(line);
+		if (!*p) continue;
+
+		char *end;
+		long frame = strtol(p, &end, 10);
+		if (end == p || !isspace((unsigned char)*end))
+		{
+			printf("Daphne: framefile line %d, expected a frame number followed by a name: %s\n", line_number, p);
+			return 0;
+		}
+
+		char *name = trim(end);
+		char *sp = name;
+		while (*sp && !isspace((unsigned char)*sp)) sp++;
+		*sp = 0;
+
+		if (segment_count >= DAPHNE_MAX_SEGMENTS)
+		{
+			printf("Daphne: framefile has more than %d entries.\n", DAPHNE_MAX_SEGMENTS);
+			return 0;
+		}
+
+		snprintf(seg_path, sizeof(seg_path), "%s%s", mpeg_path, name);
+		int file = add_file(seg_path);
+		if (file < 0)
+		{
+			printf("Daphne: framefile line %d, cannot use %s\n", line_number, seg_path);
+			return 0;
+		}
+
+		segments[segment_count].frame = (int32_t)frame;
+		segments[segment_count].file = file;
+		segment_count++;
+	}
+
+	if (!segment_count) printf("Daphne: framefile %s has no entries.\n", framefile);
+	return segment_count;
+}
+
+int daphne_lib_open(const char *framefile)
+{
+	char ff_path[1024];
+
+	daphne_lib_close();
+
+	// file_io treats relative names as relative to the storage root, framefiles are relative to us
+	if (framefile[0] != '/')
+	{
+		char cwd[512];
+		if (!getcwd(cwd, sizeof(cwd))) return 0;
+		snprintf(ff_path, sizeof(ff_path), "%s/%s", cwd, framefile);
+	}
+	else
+	{
+		snprintf(ff_path, sizeof(ff_path), "%s", framefile);
+	}
+
+	int size = FileLoad(ff_path, 0, 0);
+	if (size <= 0)
+	{
+		printf("Daphne: cannot open framefile %s\n", ff_path);
+		return 0;
+	}
+
+	char *ff_buf = (char *)malloc(size + 1);
+	if (!ff_buf) return 0;
+
+	size = FileLoad(ff_path, ff_buf, size);
+	ff_buf[(size > 0) ? size : 0] = 0;
+
+	int ok = parse_framefile(ff_buf, ff_path);
+	free(ff_buf);
+
+	if (!ok)
+	{
+		daphne_lib_close();
+		return 0;
+	}
+
+	cur_segment = 0;
+	FileSeek(&files[segments[0].file]->f, 0, SEEK_SET);
+
+	printf("Daphne: %d segment(s) in %d file(s) from %s\n", segment_count, file_count, ff_path);
+	return segment_count;
+}
+
+void daphne_lib_close()
+{
+	for (int i = 0; i < file_count; i++)
+	{
+		delete files[i];
+		files[i] = 0;
+	}
+
+	file_count = 0;
+	segment_count = 0;
+	cur_segment = -1;
+	pending_header = 0;
+	pending_size = 0;
+}
+
+int daphne_lib_segments()
+{
+	return segment_count;
+}
+
+int32_t daphne_lib_segment_frame(int segment)
+{
+	return (segment >= 0 && segment < segment_count) ? segments[segment].frame : -1;
+}
+
+const char *daphne_lib_segment_path(int segment)
+{
+	return (segment >= 0 && segment < segment_count) ? files[segments[segment].file]->path : 0;
+}
+
+unsigned int daphne_lib_sequence_fpks(const uint8_t *buf, int len)
+{
+	// ISO 13818-2 table 6-4
+	static const unsigned int fpks[16] = { 0, 23976, 24000, 25000, 29970, 30000, 50000, 59940, 60000 };
+	uint32_t val = 0;
+
+	for (int i = 0; i + 4 < len; i++)
+	{
+		val = (val << 8) | buf[i];
+		if (val == 0x000001B3) return fpks[buf[i + 4] & 0xF];
+	}
+	return 0;
+}
+
+unsigned int daphne_lib_fpks()
+{
+	if (!segment_count) return 0;
+	daphne_file *df = files[segments[0].file];
+	return daphne_lib_sequence_fpks(df->header, df->header_size);
+}
+
+int daphne_lib_locate(int32_t frame, daphne_location *loc)
+{
+	if (!segment_count || frame < segments[0].frame) return 0;
+
+	int seg = 0;
+	while ((seg + 1 < segment_count) && (frame >= segments[seg + 1].frame)) seg++;
+
+	daphne_file *df = files[segments[seg].file];
+	uint32_t mpeg_frame = frame - segments[seg].frame;
+	uint32_t actual = df->uses_fields ? (mpeg_frame << 1) : mpeg_frame;
+
+	if (actual >= df->index.size())
+	{
+		printf("Daphne: frame %d is past the end of %s\n", frame, df->path);
+		return 0;
+	}
+
+	// walk back to the I frame VLDP would pick: at least two I frames back
+	// when the first one is too close for the B frames to have their references
+	uint32_t pos = df->index[actual];
+	uint32_t skip = 0;
+	int skipped_I = 0;
+	for (;;)
+	{
+		while ((pos == DAPHNE_NO_IFRAME) && (actual > 0))
+		{
+			skip++;
+			actual--;
+			pos = df->index[actual];
+		}
+		skipped_I++;
+
+		if ((skipped_I < 2) && (skip < 3) && (actual > 0)) pos = DAPHNE_NO_IFRAME;
+		else break;
+	}
+	if (pos == DAPHNE_NO_IFRAME) pos = 0;
+
+	loc->segment = seg;
+	loc->file = segments[seg].file;
+	loc->offset = pos;
+	loc->mpeg_frame = mpeg_frame;
+	loc->skip = skip;
+	return 1;
+}
+
+int daphne_lib_seek(int32_t frame)
+{
+	daphne_location loc;
+	if (!daphne_lib_locate(frame, &loc)) return 0;
+
+	daphne_file *df = files[loc.file];
+	if (!FileSeek(&df->f, loc.offset, SEEK_SET)) return 0;
+
+	cur_segment = loc.segment;
+	pending_header = df->header;
+	pending_size = loc.offset ? df->header_size : 0;
+
+	printf("Daphne: seek to frame %d, %s at 0x%llx, %u frame(s) to skip\n",
+		frame, df->path, (unsigned long long)loc.offset, loc.skip);
+	return 1;
+}
+
+int daphne_lib_read(void *buf, int len)
+{
+	uint8_t *p = (uint8_t *)buf;
+	int total = 0;
+
+	while (total < len && cur_segment >= 0)
+	{
+		if (pending_size)
+		{
+			int n = (pending_size < len - total) ? pending_size : len - total;
+			memcpy(p + total, pending_header, n);
+			pending_header += n;
+			pending_size -= n;
+			total += n;
+			continue;
+		}
+
+		int ret = FileReadAdv(&files[segments[cur_segment].file]->f, p + total, len - total);
+		if (ret > 0)
+		{
+			total += ret;
+			continue;
+		}
+
+		// end of this segment, carry on with the next one (already open)
+		if (cur_segment + 1 >= segment_count) break;
+		cur_segment++;
+		FileSeek(&files[segments[cur_segment].file]->f, 0, SEEK_SET);
+	}
+
+	return total;
+}
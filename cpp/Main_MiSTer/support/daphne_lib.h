@@ -0,0 +1,51 @@
+#ifndef DAPHNE_LIB_H
+#define DAPHNE_LIB_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+// maximum # of mpeg segments a framefile may list (same limit as VLDP)
+#define DAPHNE_MAX_SEGMENTS 500
+
+// .dat index format written by VLDP's mpegscan
+#define DAPHNE_DAT_VERSION  2
+#define DAPHNE_NO_IFRAME    0xFFFFFFFF
+
+// where a laserdisc frame lives inside the library
+struct daphne_location
+{
+	int       segment;     // framefile entry holding the frame
+	int       file;        // open file backing that segment
+	__off64_t offset;      // file offset of the I frame decoding must start from
+	uint32_t  mpeg_frame;  // requested frame relative to the start of the segment
+	uint32_t  skip;        // frames to decode and drop after the I frame
+};
+
+// Parses the framefile, opens every referenced m2v once and loads (or builds) its .dat index.
+// Returns the number of segments, or 0 on failure.
+int  daphne_lib_open(const char *framefile);
+void daphne_lib_close();
+
+int         daphne_lib_segments();
+int32_t     daphne_lib_segment_frame(int segment);
+const char *daphne_lib_segment_path(int segment);
+
+// Resolves a laserdisc frame to a file and offset without touching the stream position.
+int daphne_lib_locate(int32_t frame, daphne_location *loc);
+
+// Moves the stream to a laserdisc frame. The cached sequence header is replayed
+// ahead of the I frame so the decoder can start mid-file.
+int daphne_lib_seek(int32_t frame);
+
+// Reads the next bytes of the stream, continuing into the following segment at EOF
+// without reopening any file. Returns the number of bytes read.
+int daphne_lib_read(void *buf, int len);
+
+// Frames per kilosecond from the frame_rate_code of the first sequence header in buf
+// (Dragon's Lair's m2v says 23976), or 0 if there is none.
+unsigned int daphne_lib_sequence_fpks(const uint8_t *buf, int len);
+
+// Frame rate of the first segment's mpeg, 0 if unknown.
+unsigned int daphne_lib_fpks();
+
+#endif
@@ -25,7 +25,6 @@ module hps_ext
 reg stream_byte_index;
 
 initial begin
-    //$readmemh("stream.dat", stream, 0, `MAX_STREAM_LENGTH);
     stream_byte_index = 0;
     stream_data  = 0;
     stream_valid = 0;
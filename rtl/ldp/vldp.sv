@@ -39,15 +39,13 @@ module vldp(
     output   reg [35:0] EXT_BUS_OUT
 );
 
-`define MAX_STREAM_LENGTH 4194559
-
 reg        frame_search_req;
 reg [31:0] frame_search;
-integer    stream_byte_index;
-reg  [7:0] stream[0:`MAX_STREAM_LENGTH];
 reg        rst_ff;
-wire  [7:0]stream_data = 0;
-wire       stream_valid = 0;
+wire  [7:0]stream_data;
+wire       stream_valid;
+wire  [7:0]hps_stream_data;
+wire       hps_stream_valid;
 wire       mpeg2_busy;
 wire [4:0] reg_addr;
 wire       reg_wr_en;
@@ -79,13 +77,52 @@ mpeg mpeg_inst(
     // Trick mode is cool, as it allows slow motion... which might come in handy
 );
 
+`ifdef SIMULATION
+// Stream bytes straight from the file the verilator harness has mapped
+// (sim/sim_stream.cpp), the HPS side keeps feeding the decoder if none is open
+import "DPI-C" function int sim_stream_byte();
+
+reg  [7:0] sim_stream_data = 0;
+reg        sim_stream_valid = 0;
+reg        sim_stream_open = 0;
+integer    sim_stream_next;
+always @(posedge sys_clk) begin
+    if (~RESET_N) begin
+        sim_stream_valid <= 1'b0;
+    end else if (~mpeg2_busy) begin
+        sim_stream_next = sim_stream_byte();
+        sim_stream_open <= sim_stream_next != -2;
+        sim_stream_data <= sim_stream_next[7:0];
+        sim_stream_valid <= sim_stream_next >= 0;
+    end else begin
+        sim_stream_valid <= 1'b0;
+    end
+end
+
+assign stream_data  = sim_stream_open ? sim_stream_data  : hps_stream_data;
+assign stream_valid = sim_stream_open ? sim_stream_valid : hps_stream_valid;
+`else
+assign stream_data  = hps_stream_data;
+assign stream_valid = hps_stream_valid;
+`endif
+
+// Bytes accepted by the decoder
+always @(posedge sys_clk) begin
+    if (~RESET_N) begin
+        stream_dat_count <= 0;
+    end else if (stream_valid) begin
+        stream_dat_count <= stream_dat_count + 1;
+    end
+end
+
 /* verilator lint_off PINMISSING */
 hps_ext hps_ext_inst(
     .reset(rst),
     .mem_clk(mem_clk),
     .sys_clk(sys_clk),
     .RESET_N(RESET_N),
-    .stream_data(stream_data),
+    .stream_data(hps_stream_data),
+    .stream_valid(hps_stream_valid),
     .frame_search_req(frame_search_req),
     .frame_search(frame_search),
     .play_req(play),
@@ -0,0 +1,63 @@
+#pragma once
+
+// Loopback stand-in for the verilated model, so the Main_MiSTer transport
+// (daphne.cpp -> user_io -> spi.cpp) can be benchmarked without verilator.
+// It plays the core's side of EXT_BUS: raises sector requests through
+// CD_GET like hps_ext.sv does, takes file data words while fp_enable is
+// high and drains them into a decoder fifo at the stream bitrate.
+
+#include <stdint.h>
+#include <vector>
+
+typedef uint64_t vluint64_t;
+
+class Vtop {
+public:
+	// Bus, same layout as the verilated ports
+	vluint64_t EXT_BUS = 0;
+	vluint64_t EXT_BUS_IN = 0;
+	vluint64_t EXT_BUS_OUT = 0;
+
+	// Model settings
+	double bytes_per_cycle = 0.0;	// decoder consumption rate
+	uint32_t sector_size = 1024;	// bytes per request, matches hps_ext.sv
+	uint32_t fifo_limit = 7168;	// request while the fifo has room for another sector
+	bool wide = false;	// data words carry 16 bits
+	vluint64_t request_timeout = 1000000;	// cycles before a request is given up on
+
+	// Results
+	vluint64_t cycle = 0;
+	vluint64_t bytes_received = 0;
+	vluint64_t bytes_consumed = 0;
+	uint32_t requests = 0;
+	uint32_t requests_served = 0;
+	uint32_t requests_timed_out = 0;
+	uint32_t underruns = 0;
+	vluint64_t starved_cycles = 0;
+	std::vector<vluint64_t> latency_cycles;	// request raised to first data word
+	std::vector<uint64_t> latency_ns;
+
+	// One bus clock
+	void eval();
+	void final() {}
+
+private:
+	uint32_t fifo = 0;
+	double drain = 0.0;
+	bool playing = false;
+	bool starved = false;
+
+	bool fp_enable_old = false;
+	bool dout_en = false;
+	uint16_t cmd = 0;
+	uint16_t fp_cmd = 0;
+	uint32_t byte_cnt = 0;
+	uint32_t fp_word_cnt = 0;
+
+	uint16_t cd_in = 0;	// last request code
+	uint8_t cd_req = 0;	// bumped for every request, as cd_put does
+	bool request_pending = false;
+	bool waiting_first = false;
+	vluint64_t request_cycle = 0;
+	uint64_t request_ns = 0;
+};
@@ -0,0 +1,152 @@
+// file_io readahead check
+// -----------------------
+// Reads a scratch file through file_io.cpp with a readahead window set and
+// compares every result with plain stdio on the same file: sequential reads
+// that straddle window boundaries, seeks in every direction, positional
+// reads (including large aligned ones that bypass the window) and reads
+// that run into EOF.
+//
+// usage: readahead_check [-w window] [-n ops] [-s seed]
+
+#include "file_io.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <vector>
+
+static uint32_t seed = 1;
+
+static uint32_t next_rand() {
+	seed = seed * 1103515245 + 12345;
+	return seed >> 8;
+}
+
+static int failures = 0;
+
+static void compare(const char* what, int op, long long offset, int got, const uint8_t* a, int want, const uint8_t* b) {
+	if (got == want && (want <= 0 || !memcmp(a, b, want))) { return; }
+	if (failures++ < 10) {
+		printf("CHECK - op %d %s at %lld: file_io returned %d, stdio %d%s\n", op, what, offset, got, want,
+			got == want ? ", data differs" : "");
+	}
+}
+
+static void compare_offset(const char* what, int op, long long got, long long want) {
+	if (got == want) { return; }
+	if (failures++ < 10) {
+		printf("CHECK - op %d %s: file_io is at %lld, stdio at %lld\n", op, what, got, want);
+	}
+}
+
+int main(int argc, char** argv) {
+	int window = 10000;
+	int ops = 20000;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-w") && i + 1 < argc) { window = atoi(argv[++i]); }
+		else if (!strcmp(argv[i], "-n") && i + 1 < argc) { ops = atoi(argv[++i]); }
+		else if (!strcmp(argv[i], "-s") && i + 1 < argc) { seed = strtoul(argv[++i], NULL, 10); }
+	}
+
+	// a few windows and a ragged tail, so reads cross boundaries and hit EOF mid-window
+	char path[] = "/tmp/readahead_checkXXXXXX";
+	int fd = mkstemp(path);
+	if (fd < 0) {
+		printf("CHECK - can't create a scratch file\n");
+		return 1;
+	}
+	int window_size = 4096;
+	while (window_size < window) window_size <<= 1;
+	std::vector<uint8_t> data(window_size * 5 + 1234);
+	for (size_t i = 0; i < data.size(); i++) { data[i] = (uint8_t)next_rand(); }
+	if (write(fd, data.data(), data.size()) != (ssize_t)data.size()) {
+		printf("CHECK - can't write %s\n", path);
+		close(fd);
+		unlink(path);
+		return 1;
+	}
+	close(fd);
+
+	fileTYPE f;
+	FILE* ref = fopen(path, "rb");
+	if (!ref || !FileOpen(&f, path) || !FileSetReadahead(&f, window)) {
+		printf("CHECK - can't open %s\n", path);
+		unlink(path);
+		return 1;
+	}
+
+	long long size = data.size();
+	std::vector<uint8_t> a(window_size * 3), b(window_size * 3);
+	for (int op = 0; op < ops; op++) {
+		uint32_t r = next_rand();
+		int len = 1 + next_rand() % (window_size + window_size / 2);
+
+		switch (r % 6) {
+		case 0:
+		case 1: {
+			// sequential read from wherever the last op left off
+			long long offset = f.offset;
+			int got = FileReadAdv(&f, a.data(), len);
+			int want = fread(b.data(), 1, len, ref);
+			compare("read", op, offset, got, a.data(), want, b.data());
+			break;
+		}
+		case 2: {
+			long long offset = next_rand() % (size + 100);
+			FileSeek(&f, offset, SEEK_SET);
+			fseeko64(ref, offset, SEEK_SET);
+			compare_offset("seek set", op, f.offset, ftello64(ref));
+			break;
+		}
+		case 3: {
+			long long delta = (long long)(next_rand() % (window_size * 2)) - window_size;
+			if (f.offset + delta < 0) { delta = -f.offset; }
+			FileSeek(&f, delta, SEEK_CUR);
+			fseeko64(ref, delta, SEEK_CUR);
+			compare_offset("seek cur", op, f.offset, ftello64(ref));
+			break;
+		}
+		case 4: {
+			long long offset = -(long long)(next_rand() % (window_size * 2));
+			FileSeek(&f, offset, SEEK_END);
+			fseeko64(ref, offset, SEEK_END);
+			compare_offset("seek end", op, f.offset, ftello64(ref));
+			break;
+		}
+		case 5: {
+			// positional, half of them window aligned and at least a window long
+			long long offset = next_rand() % (size + 100);
+			if (r & 8) {
+				offset &= ~(long long)(window_size - 1);
+				len = window_size * (1 + next_rand() % 2) + next_rand() % 100;
+			}
+			long long before = f.offset;
+			int got = FileReadAt(&f, offset, a.data(), len);
+			fseeko64(ref, offset, SEEK_SET);
+			int want = fread(b.data(), 1, len, ref);
+			fseeko64(ref, before, SEEK_SET);
+			compare("read at", op, offset, got, a.data(), want, b.data());
+			compare_offset("read at", op, f.offset, before);
+			break;
+		}
+		}
+	}
+
+	// oversize windows are clamped instead of overflowing the rounding
+	int clamped = FileSetReadahead(&f, INT_MAX) && f.ra_size == FILE_READAHEAD_MAX;
+	if (!clamped) {
+		printf("CHECK - FileSetReadahead(INT_MAX) gave a %d byte window\n", f.ra_size);
+		failures++;
+	}
+
+	FileClose(&f);
+	fclose(ref);
+	unlink(path);
+
+	printf("CHECK - %d ops on a %lld byte file with a %d byte window: %s (%d failures)\n", ops, size, window_size,
+		failures ? "FAIL" : "ok", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,306 @@
+// HPS -> FPGA streaming benchmark
+// ------------------------------
+// Drives daphne_poll() against the loopback model in Vtop.h one bus clock at a time,
+// the same way sim_main.cpp does with the real core, and reports sustained throughput,
+// request-to-first-byte latency and decoder underruns against the stream bitrate.
+//
+// usage: stream_bench [options] framefile
+//        stream_bench [options] -s seconds      (synthetic stream)
+//   -c hz       bus clock (default 100000000, clk_sys in the sim)
+//   -n cycles   cycles to run (default one simulated second)
+//   -r bps      stream bitrate (default: taken from the sequence header)
+//   -w          16-bit data words (fio_size = 1)
+//   -g cycles   idle cycles after each data word (default 3, the fpga_spi handshake)
+//   -v          keep the transport's own logging
+
+#include "Vtop.h"
+#include "daphne.h"
+#include "daphne_lib.h"
+#include "user_io.h"
+#include "spi.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <algorithm>
+#include <chrono>
+
+Vtop* top = NULL;
+
+static void bench_tick() {
+	top->eval();
+}
+
+static uint64_t now_ns() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Loopback model
+// --------------
+void Vtop::eval() {
+	cycle++;
+
+	vluint64_t bus = EXT_BUS | EXT_BUS_IN;
+	bool io_strobe = (bus >> 33) & 1;
+	bool io_enable = (bus >> 34) & 1;
+	bool fp_enable = (bus >> 35) & 1;
+	uint16_t io_din = (EXT_BUS_IN >> 16) & 0xFFFF;
+	uint16_t io_dout = 0;
+
+	// uio side, answers CD_GET like hps_ext.sv: the request count, then the request code
+	if (!io_enable) {
+		dout_en = false;
+		byte_cnt = 0;
+	}
+	else if (io_strobe && !fp_enable) {
+		if (byte_cnt == 0) {
+			cmd = io_din;
+			dout_en = (cmd == UIO_CD_GET || cmd == UIO_CD_SET);
+			if (cmd == UIO_CD_GET) { io_dout = cd_req; }
+		}
+		else if (cmd == UIO_CD_GET && byte_cnt == 1) {
+			io_dout = cd_in;
+		}
+		byte_cnt++;
+	}
+
+	// file side, one word per strobe while fp_enable is high
+	if (fp_enable) {
+		if (!fp_enable_old) { fp_word_cnt = 0; }
+		if (io_strobe) {
+			if (fp_word_cnt == 0) {
+				fp_cmd = io_din & 0xFF;
+			}
+			else if (fp_cmd == FIO_FILE_TX_DAT) {
+				uint32_t n = wide ? 2 : 1;
+				if (waiting_first && request_pending) {
+					latency_cycles.push_back(cycle - request_cycle);
+					latency_ns.push_back(now_ns() - request_ns);
+					waiting_first = false;
+				}
+				bytes_received += n;
+				fifo += n;
+				playing = true;
+			}
+			fp_word_cnt++;
+		}
+	}
+	else if (fp_enable_old && fp_cmd == FIO_FILE_TX_DAT) {
+		if (request_pending && !waiting_first) {
+			requests_served++;
+			request_pending = false;
+		}
+		fp_cmd = 0;
+	}
+	fp_enable_old = fp_enable;
+
+	// ask for the next sector whenever there is room for it
+	if (!request_pending && fifo + sector_size <= fifo_limit) {
+		request_pending = true;
+		waiting_first = true;
+		cd_in = 0x37;
+		cd_req++;
+		request_cycle = cycle;
+		request_ns = now_ns();
+		requests++;
+	}
+	else if (request_pending && waiting_first && (cycle - request_cycle) > request_timeout) {
+		requests_timed_out++;
+		request_pending = false;
+	}
+
+	// decoder drains the fifo at the stream bitrate once data has started arriving
+	if (playing) {
+		drain += bytes_per_cycle;
+		while (drain >= 1.0) {
+			drain -= 1.0;
+			if (fifo) {
+				fifo--;
+				bytes_consumed++;
+				starved = false;
+			}
+			else {
+				if (!starved) { underruns++; }
+				starved = true;
+			}
+		}
+		if (starved) { starved_cycles++; }
+	}
+
+	EXT_BUS_OUT = ((vluint64_t)dout_en << 32) | io_dout;
+}
+
+// Streams
+// -------
+static uint32_t stream_bitrate(const char* path) {
+	uint8_t hdr[12];
+	FILE* f = fopen(path, "rb");
+	if (!f) { return 0; }
+	size_t n = fread(hdr, 1, sizeof(hdr), f);
+	fclose(f);
+
+	if (n < sizeof(hdr) || hdr[0] || hdr[1] || hdr[2] != 1 || hdr[3] != 0xB3) { return 0; }
+	uint32_t value = (hdr[8] << 10) | (hdr[9] << 2) | (hdr[10] >> 6);
+	return (value == 0x3FFFF) ? 0 : value * 400;	// 0x3FFFF marks variable bitrate
+}
+
+// Writes an I/B/P patterned elementary stream of the given bitrate and a framefile for it
+static bool make_synthetic(const char* dir, double seconds, uint32_t bitrate, char* framefile, size_t len) {
+	char m2v[1024];
+	snprintf(m2v, sizeof(m2v), "%s/stream_bench.m2v", dir);
+	snprintf(framefile, len, "%s/stream_bench.txt", dir);
+
+	FILE* f = fopen(m2v, "wb");
+	if (!f) { return false; }
+
+	uint32_t value = bitrate / 400;
+	uint32_t vbv = 112;
+	uint8_t seq[] = { 0, 0, 1, 0xB3, 0x2D, 0x01, 0xE0, 0x24,
+		(uint8_t)(value >> 10), (uint8_t)(value >> 2), (uint8_t)(((value & 3) << 6) | 0x20 | ((vbv >> 5) & 0x1F)), (uint8_t)((vbv & 0x1F) << 3) };
+	fwrite(seq, 1, sizeof(seq), f);
+
+	const char* pattern = "IBBPBBPBBPBB";
+	int frames = (int)(seconds * 29.97);
+	int picture_size = (int)(bitrate / 8 / 29.97);
+	uint32_t lcg = 1;
+	for (int i = 0; i < frames; i++) {
+		char type = pattern[i % 12];
+		if (type == 'I') {
+			uint8_t gop[] = { 0, 0, 1, 0xB8, 0x00, 0x08, 0x00, 0x40 };
+			fwrite(gop, 1, sizeof(gop), f);
+		}
+		uint8_t pic[] = { 0, 0, 1, 0x00, 0x00, (uint8_t)(((type == 'I') ? 1 : (type == 'P') ? 2 : 3) << 3), 0xFF, 0xF8,
+			0, 0, 1, 0x01 };
+		fwrite(pic, 1, sizeof(pic), f);
+		// payload never contains a start code
+		for (int b = 0; b < picture_size; b++) {
+			lcg = lcg * 1103515245 + 12345;
+			fputc(1 + ((lcg >> 16) % 255), f);
+		}
+	}
+	uint8_t end[] = { 0, 0, 1, 0xB7 };
+	fwrite(end, 1, sizeof(end), f);
+	fclose(f);
+
+	f = fopen(framefile, "w");
+	if (!f) { return false; }
+	fprintf(f, ".\n\n0\tstream_bench.m2v\n");
+	fclose(f);
+	return true;
+}
+
+static vluint64_t percentile(std::vector<vluint64_t> v, double p) {
+	if (v.empty()) { return 0; }
+	std::sort(v.begin(), v.end());
+	size_t i = (size_t)(p * v.size());
+	return v[std::min(i, v.size() - 1)];
+}
+
+int main(int argc, char** argv) {
+	double clock_hz = 100000000.0;
+	vluint64_t cycles = 0;
+	uint32_t bitrate = 0;
+	double synthetic = 0.0;
+	bool wide = false;
+	bool verbose = false;
+	int word_gap = 3;
+	char framefile[1024] = {};
+
+	int opt;
+	while ((opt = getopt(argc, argv, "c:n:r:s:g:wv")) != -1) {
+		switch (opt) {
+		case 'c': clock_hz = atof(optarg); break;
+		case 'n': cycles = strtoull(optarg, NULL, 10); break;
+		case 'r': bitrate = strtoul(optarg, NULL, 10); break;
+		case 's': synthetic = atof(optarg); break;
+		case 'w': wide = true; break;
+		case 'g': word_gap = atoi(optarg); break;
+		case 'v': verbose = true; break;
+		default:
+			fprintf(stderr, "usage: %s [-c hz] [-n cycles] [-r bps] [-g cycles] [-w] [-v] (framefile | -s seconds)\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (synthetic > 0.0) {
+		const char* tmp = getenv("TMPDIR");
+		if (!bitrate) { bitrate = 5000000; }
+		if (!make_synthetic(tmp ? tmp : "/tmp", synthetic, bitrate, framefile, sizeof(framefile))) {
+			fprintf(stderr, "could not write synthetic stream\n");
+			return 1;
+		}
+	}
+	else if (optind < argc) {
+		snprintf(framefile, sizeof(framefile), "%s", argv[optind]);
+	}
+	else {
+		fprintf(stderr, "no framefile given\n");
+		return 1;
+	}
+	if (!cycles) { cycles = (vluint64_t)clock_hz; }
+
+	// the transport logs every bus transition, keep the report readable
+	int report_fd = dup(1);
+	if (!verbose) { freopen("/dev/null", "w", stdout); }
+
+	top = new Vtop();
+	top->wide = wide;
+	spi_bus_init(bench_tick, wide, word_gap);
+	daphne_init(framefile);
+
+	if (!daphne_lib_segments()) {
+		fprintf(stderr, "could not open %s\n", framefile);
+		return 1;
+	}
+	if (!bitrate) { bitrate = stream_bitrate(daphne_lib_segment_path(0)); }
+	if (!bitrate) {
+		fprintf(stderr, "stream has no fixed bitrate, pass one with -r\n");
+		return 1;
+	}
+	top->bytes_per_cycle = bitrate / 8.0 / clock_hz;
+
+	auto start = std::chrono::steady_clock::now();
+	while (top->cycle < cycles) {
+		top->eval();
+		daphne_poll();
+	}
+	double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	fflush(stdout);
+	FILE* out = fdopen(report_fd, "w");
+	const daphne_stream_stats* stats = daphne_get_stats();
+	double sim_seconds = top->cycle / clock_hz;
+	double need = bitrate / 8.0;
+
+	fprintf(out, "stream      %s, %.3f Mbit/s, %s data words\n", framefile, bitrate / 1000000.0, wide ? "16-bit" : "8-bit");
+	fprintf(out, "cycles      %lu at %.2f MHz = %.4fs simulated, %.3fs wall (%.0f cycles/s)\n",
+		top->cycle, clock_hz / 1000000.0, sim_seconds, wall, top->cycle / wall);
+	fprintf(out, "requests    %u raised, %u served, %u timed out, %u handled by daphne_poll\n",
+		top->requests, top->requests_served, top->requests_timed_out, stats->requests);
+	fprintf(out, "bytes       %lu sent, %lu received on the bus, %lu consumed\n",
+		stats->bytes, top->bytes_received, top->bytes_consumed);
+	fprintf(out, "sustained   %.0f bytes/s simulated (stream needs %.0f, %.2fx), %.2f MB/s wall\n",
+		top->bytes_received / sim_seconds, need, top->bytes_received / sim_seconds / need, top->bytes_received / wall / 1000000.0);
+
+	if (top->latency_cycles.empty()) {
+		fprintf(out, "latency     no data reached the bus\n");
+	}
+	else {
+		std::vector<vluint64_t> ns(top->latency_ns.begin(), top->latency_ns.end());
+		fprintf(out, "latency     cycles p50 %lu  p90 %lu  p99 %lu  max %lu\n",
+			percentile(top->latency_cycles, 0.50), percentile(top->latency_cycles, 0.90),
+			percentile(top->latency_cycles, 0.99), percentile(top->latency_cycles, 1.0));
+		fprintf(out, "            wall   p50 %.1fus  p90 %.1fus  p99 %.1fus  max %.1fus\n",
+			percentile(ns, 0.50) / 1000.0, percentile(ns, 0.90) / 1000.0,
+			percentile(ns, 0.99) / 1000.0, percentile(ns, 1.0) / 1000.0);
+	}
+	fprintf(out, "underruns   %u (%lu cycles starved)\n", top->underruns, top->starved_cycles);
+	fclose(out);
+
+	delete top;
+	return 0;
+}
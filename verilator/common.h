@@ -2,7 +2,4 @@
 #define COMMON_H_
 #include "Vtop.h"
 extern Vtop* top;
-extern uint16_t last_command;
-extern uint16_t last_command_data1;
-extern uint16_t last_command_data2;
 #endif
\ No newline at end of file
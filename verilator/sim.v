@@ -18,6 +18,10 @@ module top(
     menu,
     reset,
     clk_sys,
+`ifdef SIM_CLOCK_DOMAINS
+    clk_50,
+    clk_25,
+`endif
     ioctl_upload,
     ioctl_download,
     ioctl_addr,
@@ -37,6 +41,10 @@ module top(
     perform_io_strobe
 );
     input clk_sys;
+`ifdef SIM_CLOCK_DOMAINS
+    input clk_50;
+    input clk_25;
+`endif
     input reset;
 
     output [7:0] VGA_R;
@@ -106,6 +114,11 @@ wire famicom_data;
 wire clk;
 wire clk_vid;
 
+`ifdef SIM_CLOCK_DOMAINS
+// The harness drives every domain at its own frequency (SimClockScheduler)
+assign clk = clk_50;
+assign clk_vid = clk_25;
+`else
 // Divide incoming clk_sys of 100 into
 // - 100 for mem_clk
 // - 50 for clk (also sys_clk)
@@ -119,6 +132,7 @@ ripple_clock_divider clk_divider(
 	// 25mhz
 	.clk_div4(clk_vid)
 );
+`endif
 
 wire pixel_en;
 
@@ -2,16 +2,208 @@
 #include <iostream>
 #include <fstream>
 #include <list>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <atomic>
+
+// Live output goes through SDL, which the Windows build doesn't use
+#ifndef _MSC_VER
+#include <SDL.h>
+#define SIMAUDIO_LIVE
+#endif
 using namespace std;
 
 SimClock clk;
 bool outputToFile;
 ofstream audioFile;
+string audioFileName;
+SimAudioFormat audioFormat;
+
+// Capture buffering
+// -----------------
+// Samples are packed into fixed size blocks. Full blocks are handed to a
+// writer thread so Clock() never touches the file, and a block is only
+// recycled once it has been written out. Clock() only waits if every block
+// is queued, so the capture stays lossless.
+#define CAPTURE_BLOCK_SIZE (64 * 1024)
+#define CAPTURE_BLOCKS 32
+
+unsigned char* captureRing = NULL;
+unsigned int captureHead;	// block being filled by Clock()
+unsigned int captureTail;	// next block the writer will flush
+unsigned int captureQueued;	// full blocks waiting for the writer
+unsigned int captureFill;	// bytes used in the head block
+bool captureStop;
+mutex captureMutex;
+condition_variable captureFull;
+condition_variable captureFree;
+thread captureThread;
+
+// WAV header
+// ----------
+// Little endian RIFF/WAVE header. Float data gets the extended fmt chunk
+// and a fact chunk as the format requires, PCM uses the plain 44 byte layout.
+static void put16(unsigned char*& p, uint16_t v) { p[0] = v; p[1] = v >> 8; p += 2; }
+static void put32(unsigned char*& p, uint32_t v) { p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24; p += 4; }
+static void putTag(unsigned char*& p, const char* tag) { memcpy(p, tag, 4); p += 4; }
+
+static int wavHeaderSize() {
+	return (audioFormat == SIMAUDIO_FLOAT32) ? 58 : 44;
+}
+
+static void writeWavHeader(int sampleRate, unsigned long long dataBytes) {
+	unsigned char header[58];
+	unsigned char* p = header;
+	int floatData = (audioFormat == SIMAUDIO_FLOAT32);
+	int sampleBytes = floatData ? 4 : 2;
+	int channels = 2;
+	// RIFF sizes are 32 bit, clamp rather than wrap on very long captures
+	uint32_t data = (dataBytes > 0xFFFFFFFFull - wavHeaderSize()) ? (uint32_t)(0xFFFFFFFFull - wavHeaderSize()) : (uint32_t)dataBytes;
+
+	putTag(p, "RIFF");
+	put32(p, wavHeaderSize() - 8 + data);
+	putTag(p, "WAVE");
+	putTag(p, "fmt ");
+	put32(p, floatData ? 18 : 16);
+	put16(p, floatData ? 3 : 1);	// WAVE_FORMAT_IEEE_FLOAT / WAVE_FORMAT_PCM
+	put16(p, channels);
+	put32(p, sampleRate);
+	put32(p, sampleRate * channels * sampleBytes);
+	put16(p, channels * sampleBytes);
+	put16(p, sampleBytes * 8);
+	if (floatData) {
+		put16(p, 0);
+		putTag(p, "fact");
+		put32(p, 4);
+		put32(p, data / (channels * sampleBytes));
+	}
+	putTag(p, "data");
+	put32(p, data);
+
+	audioFile.seekp(0);
+	audioFile.write((const char*)header, p - header);
+}
+
+static void captureWriter() {
+	unique_lock<mutex> lock(captureMutex);
+	for (;;) {
+		captureFull.wait(lock, [] { return captureQueued > 0 || captureStop; });
+		if (captureQueued == 0) { break; }
+		unsigned char* block = captureRing + (captureTail * CAPTURE_BLOCK_SIZE);
+		lock.unlock();
+		audioFile.write((const char*)block, CAPTURE_BLOCK_SIZE);
+		lock.lock();
+		captureTail = (captureTail + 1) % CAPTURE_BLOCKS;
+		captureQueued--;
+		captureFree.notify_one();
+	}
+}
+
+#ifdef SIMAUDIO_LIVE
+// Live output
+// -----------
+// Clock() pushes frames into a single producer / single consumer ring that
+// the SDL callback drains, so the sim thread never blocks on the device.
+// The sim rarely runs at real time, so the callback measures how fast
+// frames are actually arriving and resamples them to the device rate,
+// nudging the step by the ring fill so latency stays near LIVE_LATENCY_MS
+// of sim output.
+#define LIVE_RING_FRAMES 16384	// power of two
+#define LIVE_LATENCY_MS 100
+#define LIVE_MIN_TARGET 64	// frames
+#define LIVE_DEVICE_SAMPLES 1024
+
+int16_t liveRing[LIVE_RING_FRAMES][2];
+atomic<uint32_t> liveWrite(0);	// only written by Clock()
+atomic<uint32_t> liveRead(0);	// only written by the callback
+atomic<uint32_t> liveUnderruns(0);
+atomic<uint32_t> liveInputRate(0);
+uint32_t liveOverruns;
+SDL_AudioDeviceID liveDevice = 0;
+int liveDeviceRate;
+bool livePlaying;
+
+// Callback side state
+double livePos;	// fractional position between the two oldest frames
+double liveRate;	// smoothed input frames per second
+uint32_t liveLastWrite;
+uint32_t liveLastTicks;
+int16_t liveHold[2];	// last frame played, faded out on underrun
+
+static void liveCallback(void* userdata, Uint8* stream, int len) {
+	int16_t* out = (int16_t*)stream;
+	int frames = len / 4;
+	uint32_t write = liveWrite.load(memory_order_acquire);
+	uint32_t read = liveRead.load(memory_order_relaxed);
+
+	// Measure the production rate over the last callback period
+	uint32_t ticks = SDL_GetTicks();
+	if (ticks != liveLastTicks) {
+		double rate = (double)(write - liveLastWrite) * 1000.0 / (double)(ticks - liveLastTicks);
+		liveRate += (rate - liveRate) * 0.1;
+		liveLastWrite = write;
+		liveLastTicks = ticks;
+		liveInputRate.store((uint32_t)liveRate, memory_order_relaxed);
+	}
+
+	// Input frames per output frame, corrected towards the target fill
+	uint32_t fill = write - read;
+	double target = (liveRate * LIVE_LATENCY_MS) / 1000.0;
+	if (target < LIVE_MIN_TARGET) { target = LIVE_MIN_TARGET; }
+	double step = (liveRate / liveDeviceRate) * (1.0 + ((double)fill - target) / (4.0 * target));
+	if (step < 1.0 / 256.0) { step = 1.0 / 256.0; }
+	if (step > 4.0) { step = 4.0; }
+
+	bool starved = false;
+	for (int i = 0; i < frames; i++) {
+		// Interpolation needs the current frame and the next one
+		if (write - read < 2) {
+			starved = true;
+			liveHold[0] = liveHold[0] * 15 / 16;
+			liveHold[1] = liveHold[1] * 15 / 16;
+			out[i * 2] = liveHold[0];
+			out[(i * 2) + 1] = liveHold[1];
+			continue;
+		}
+		int16_t* a = liveRing[read & (LIVE_RING_FRAMES - 1)];
+		int16_t* b = liveRing[(read + 1) & (LIVE_RING_FRAMES - 1)];
+		liveHold[0] = (int16_t)(a[0] + ((b[0] - a[0]) * livePos));
+		liveHold[1] = (int16_t)(a[1] + ((b[1] - a[1]) * livePos));
+		out[i * 2] = liveHold[0];
+		out[(i * 2) + 1] = liveHold[1];
+
+		livePos += step;
+		uint32_t advance = (uint32_t)livePos;
+		if (advance > write - read - 1) { advance = write - read - 1; }
+		read += advance;
+		livePos -= (double)(uint32_t)livePos;
+	}
+	if (starved) { liveUnderruns.fetch_add(1, memory_order_relaxed); }
+	liveRead.store(read, memory_order_release);
+}
+#endif
 
-SimAudio::SimAudio(int systemClockFrequency, bool saveToFile)
+SimAudio::SimAudio(int systemClockFrequency, bool saveToFile, SimAudioFormat format, const char* fileName)
 {
 	clk = SimClock(systemClockFrequency / 44100);
 	outputToFile = saveToFile;
+	audioFormat = format;
+	audioFileName = fileName;
+	// SimClock rises once every ratio + 1 ticks, record the rate that actually results
+	sample_rate = (int)((systemClockFrequency + ((systemClockFrequency / 44100) + 1) / 2) / ((systemClockFrequency / 44100) + 1));
+	samples_clocked = 0;
+	samples_written = 0;
+	capture_stalls = 0;
+	playback = true;
+	output_rate = 0;
+	underruns = 0;
+	overruns = 0;
+	buffered = 0;
+	input_rate = 0;
 }
 
 SimAudio::~SimAudio()
@@ -22,10 +214,44 @@ SimAudio::~SimAudio()
 void SimAudio::Clock(signed short left, signed short right) {
 	clk.Tick();
 	if (clk.IsRising()) {
-		// Output audio (left channel only for now)
-		float l = left / 32768.0f;
-		if (outputToFile) {
-			audioFile.write((const char*)&l, sizeof(float));
+		samples_clocked++;
+#ifdef SIMAUDIO_LIVE
+		if (livePlaying) {
+			uint32_t write = liveWrite.load(memory_order_relaxed);
+			if (write - liveRead.load(memory_order_acquire) < LIVE_RING_FRAMES) {
+				liveRing[write & (LIVE_RING_FRAMES - 1)][0] = left;
+				liveRing[write & (LIVE_RING_FRAMES - 1)][1] = right;
+				liveWrite.store(write + 1, memory_order_release);
+			}
+			else {
+				liveOverruns++;
+			}
+		}
+#endif
+		if (outputToFile && captureRing) {
+			unsigned char* p = captureRing + (captureHead * CAPTURE_BLOCK_SIZE) + captureFill;
+			if (audioFormat == SIMAUDIO_FLOAT32) {
+				float s[2] = { left / 32768.0f, right / 32768.0f };
+				memcpy(p, s, sizeof(s));
+				captureFill += sizeof(s);
+			}
+			else {
+				int16_t s[2] = { left, right };
+				memcpy(p, s, sizeof(s));
+				captureFill += sizeof(s);
+			}
+			samples_written++;
+			if (captureFill == CAPTURE_BLOCK_SIZE) {
+				unique_lock<mutex> lock(captureMutex);
+				if (captureQueued == CAPTURE_BLOCKS - 1) {
+					capture_stalls++;
+					captureFree.wait(lock, [] { return captureQueued < CAPTURE_BLOCKS - 1; });
+				}
+				captureHead = (captureHead + 1) % CAPTURE_BLOCKS;
+				captureQueued++;
+				captureFill = 0;
+				captureFull.notify_one();
+			}
 		}
 	}
 }
@@ -40,6 +266,29 @@ void SimAudio::CollectDebug(signed short left, signed short right) {
 
 }
 
+void SimAudio::UpdateOutput(bool running) {
+#ifdef SIMAUDIO_LIVE
+	if (!liveDevice) { return; }
+	// Hold the device while the sim is stopped so the pause isn't counted as underruns
+	bool play = running && playback;
+	if (play != livePlaying) {
+		if (play) {
+			// Restart the rate measurement, the pause would read as a stall
+			SDL_LockAudioDevice(liveDevice);
+			liveLastWrite = liveWrite.load(memory_order_relaxed);
+			liveLastTicks = SDL_GetTicks();
+			SDL_UnlockAudioDevice(liveDevice);
+		}
+		SDL_PauseAudioDevice(liveDevice, play ? 0 : 1);
+		livePlaying = play;
+	}
+	buffered = liveWrite.load(memory_order_relaxed) - liveRead.load(memory_order_relaxed);
+	underruns = liveUnderruns.load(memory_order_relaxed);
+	overruns = liveOverruns;
+	input_rate = (float)liveInputRate.load(memory_order_relaxed);
+#endif
+}
+
 void SimAudio::Initialise() {
 	// Reset plot data
 	for (int c = 0; c < debug_max_samples; c++) {
@@ -47,16 +296,86 @@ void SimAudio::Initialise() {
 		debug_wave_r[c] = 0;
 		debug_positions[c] = (double)c / (double)debug_max_samples;
 	}
+	samples_clocked = 0;
+
+#ifdef SIMAUDIO_LIVE
+	// Open the live output device, the sim carries on silently if there isn't one
+	if (SDL_InitSubSystem(SDL_INIT_AUDIO) == 0) {
+		SDL_AudioSpec want, have;
+		memset(&want, 0, sizeof(want));
+		want.freq = 44100;
+		want.format = AUDIO_S16SYS;
+		want.channels = 2;
+		want.samples = LIVE_DEVICE_SAMPLES;
+		want.callback = liveCallback;
+		liveWrite.store(0);
+		liveRead.store(0);
+		liveUnderruns.store(0);
+		liveInputRate.store(0);
+		liveOverruns = 0;
+		livePos = 0;
+		liveRate = 0;
+		liveLastWrite = 0;
+		liveLastTicks = SDL_GetTicks();
+		liveHold[0] = liveHold[1] = 0;
+		liveDevice = SDL_OpenAudioDevice(NULL, 0, &want, &have, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
+		if (liveDevice) {
+			liveDeviceRate = have.freq;
+			output_rate = have.freq;
+			livePlaying = false;	// started by UpdateOutput
+		}
+		else {
+			printf("SimAudio: no audio output (%s)\n", SDL_GetError());
+		}
+	}
+#endif
 	if (outputToFile)
 	{
-		// Setup Audio output stream
-		audioFile.open("audio.wav", ios::binary);
+		// Setup Audio output stream, the header is rewritten with the real sizes on CleanUp
+		audioFile.open(audioFileName.c_str(), ios::binary | ios::trunc);
+		if (!audioFile.is_open()) {
+			printf("SimAudio: unable to open %s\n", audioFileName.c_str());
+			outputToFile = false;
+			return;
+		}
+		writeWavHeader(sample_rate, 0);
+
+		captureRing = new unsigned char[CAPTURE_BLOCK_SIZE * CAPTURE_BLOCKS];
+		captureHead = 0;
+		captureTail = 0;
+		captureQueued = 0;
+		captureFill = 0;
+		captureStop = false;
+		samples_written = 0;
+		capture_stalls = 0;
+		captureThread = thread(captureWriter);
 	}
 }
 void SimAudio::CleanUp() {
-	if (outputToFile)
+#ifdef SIMAUDIO_LIVE
+	if (liveDevice)
 	{
+		SDL_CloseAudioDevice(liveDevice);
+		liveDevice = 0;
+		livePlaying = false;
+		SDL_QuitSubSystem(SDL_INIT_AUDIO);
+	}
+#endif
+	if (outputToFile && captureRing)
+	{
+		// Let the writer drain the queued blocks, then append the partial one
+		{
+			lock_guard<mutex> lock(captureMutex);
+			captureStop = true;
+		}
+		captureFull.notify_one();
+		captureThread.join();
+		audioFile.write((const char*)(captureRing + (captureHead * CAPTURE_BLOCK_SIZE)), captureFill);
+
+		writeWavHeader(sample_rate, samples_written * ((audioFormat == SIMAUDIO_FLOAT32) ? 8 : 4));
 		audioFile.close();
+
+		delete[] captureRing;
+		captureRing = NULL;
 	}
 }
-
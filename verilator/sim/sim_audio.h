@@ -3,6 +3,12 @@
 #include <string>
 #include "sim_clock.h"
 
+// Sample format used when capturing to file
+enum SimAudioFormat {
+	SIMAUDIO_INT16,
+	SIMAUDIO_FLOAT32
+};
+
 struct SimAudio {
 public:
 
@@ -14,10 +20,26 @@ public:
 	float debug_wave_r[debug_max_samples];
 	int debug_pos;
 
-	SimAudio(int systemClockFrequency, bool saveToFile);
+	int sample_rate;
+	unsigned long long samples_clocked;	// samples produced so far
+
+	// Capture stats
+	unsigned long long samples_written;
+	unsigned int capture_stalls;	// times Clock() waited on the writer thread
+
+	// Live output
+	bool playback;	// feed the SDL device, can be toggled while running
+	int output_rate;	// device rate, 0 if no device could be opened
+	unsigned int underruns;	// device wanted samples the sim had not produced yet
+	unsigned int overruns;	// samples dropped because the ring was full
+	int buffered;	// frames waiting in the ring
+	float input_rate;	// rate the sim is producing samples at, in real time
+
+	SimAudio(int systemClockFrequency, bool saveToFile, SimAudioFormat format = SIMAUDIO_INT16, const char* fileName = "audio.wav");
 	~SimAudio();
 	void Clock(signed short left, signed short right);
 	void CollectDebug(signed short left, signed short right);
+	void UpdateOutput(bool running);
 	void Initialise();
 	void CleanUp();
 };
@@ -0,0 +1,154 @@
+#include "sim_avsync.h"
+#include <math.h>
+
+// Samples per timestamped audio block
+#define AVSYNC_AUDIO_BLOCK 512
+// Frames after a search before the drift estimate is trusted
+#define AVSYNC_DRIFT_FRAMES 30
+
+SimAVSync::SimAVSync(int systemClockFrequency, unsigned int fpks, int sampleRate) {
+	cycles_per_ms = systemClockFrequency / 1000.0;
+	frame_fpks = 0;
+	SetFrameRate(fpks);
+	samples_per_ms = sampleRate / 1000.0;
+	log = NULL;
+
+	frames = 0;
+	audio_blocks = 0;
+	searches = 0;
+	offset_ms = 0;
+	worst_offset_ms = 0;
+	worst_offset_time = 0;
+	worst_resync_ms = 0;
+	drift_ms_per_s = 0;
+	worst_drift_ms_per_s = 0;
+
+	speed_num = 1;
+	speed_den = 1;
+	block_samples = 0;
+	block_time = 0;
+	samples_seen = 0;
+	Search(0, 0);
+	searches = 0;
+}
+
+SimAVSync::~SimAVSync() {
+}
+
+void SimAVSync::Search(int32_t frame, uint64_t time) {
+	searches++;
+	search_frame = frame;
+	search_time = time;
+	search_samples = samples_seen;
+	awaiting_first_frame = true;
+	video_frame = frame;
+	fit_n = fit_t = fit_o = fit_tt = fit_to = 0;
+	drift_ms_per_s = 0;
+}
+
+void SimAVSync::SetSpeed(unsigned int numerator, unsigned int denominator) {
+	speed_num = numerator;
+	speed_den = denominator ? denominator : 1;
+}
+
+void SimAVSync::SetFrameRate(unsigned int fpks) {
+	if (!fpks || fpks == frame_fpks) { return; }
+	if (frame_fpks) { printf("AVSYNC - frame rate %.3f fps from the stream\n", fpks / 1000.0); }
+	frame_fpks = fpks;
+	frame_ms = 1000000.0 / fpks;
+}
+
+void SimAVSync::FrameDisplayed(uint64_t time) {
+	// The first frame after a search is the target itself
+	if (!awaiting_first_frame) {
+		video_frame += (double)speed_num / speed_den;
+	}
+	Measure(time);
+}
+
+void SimAVSync::FrameNumber(int32_t frame, uint64_t time) {
+	video_frame = frame;
+	Measure(time);
+}
+
+void SimAVSync::AudioClock(uint64_t samples, uint64_t time) {
+	samples_seen = samples;
+	if (samples - block_samples >= AVSYNC_AUDIO_BLOCK) {
+		block_samples = samples;
+		block_time = time;
+		audio_blocks++;
+	}
+}
+
+void SimAVSync::Measure(uint64_t time) {
+	frames++;
+	// Nothing to compare against until the core produces audio
+	if (!samples_seen) {
+		awaiting_first_frame = false;
+		return;
+	}
+
+	// Audio position at this frame: the last block plus the time since it,
+	// never more than the samples actually produced
+	double samples = (double)block_samples + ((time - block_time) / cycles_per_ms) * samples_per_ms;
+	if (samples > samples_seen) { samples = samples_seen; }
+	double played = samples - search_samples;
+	if (played < 0) { played = 0; }
+
+	double video_ms = video_frame * frame_ms;
+	double audio_ms = (search_frame * frame_ms) + (played / samples_per_ms);
+	offset_ms = audio_ms - video_ms;
+
+	if (fabs(offset_ms) > fabs(worst_offset_ms)) {
+		worst_offset_ms = offset_ms;
+		worst_offset_time = time;
+	}
+	if (awaiting_first_frame) {
+		awaiting_first_frame = false;
+		if (searches && fabs(offset_ms) > fabs(worst_resync_ms)) { worst_resync_ms = offset_ms; }
+	}
+
+	// Drift is the slope of the offset over the frames since the search
+	double t = (time - search_time) / (cycles_per_ms * 1000.0);
+	fit_n++;
+	fit_t += t;
+	fit_o += offset_ms;
+	fit_tt += t * t;
+	fit_to += t * offset_ms;
+	double d = (fit_n * fit_tt) - (fit_t * fit_t);
+	if (fit_n >= AVSYNC_DRIFT_FRAMES && d > 0) {
+		drift_ms_per_s = ((fit_n * fit_to) - (fit_t * fit_o)) / d;
+		if (fabs(drift_ms_per_s) > fabs(worst_drift_ms_per_s)) { worst_drift_ms_per_s = drift_ms_per_s; }
+	}
+
+	if (log) {
+		fprintf(log, "%llu,%.2f,%.3f,%.3f,%.3f\n", (unsigned long long)time, video_frame, video_ms, audio_ms, offset_ms);
+	}
+}
+
+bool SimAVSync::OpenLog(const char* fileName) {
+	log = fopen(fileName, "w");
+	if (!log) {
+		printf("AVSYNC - unable to open %s\n", fileName);
+		return false;
+	}
+	fprintf(log, "time,frame,video_ms,audio_ms,offset_ms\n");
+	return true;
+}
+
+void SimAVSync::Report() {
+	printf("AVSYNC - %u frames, %u audio blocks, %u searches\n", frames, audio_blocks, searches);
+	if (!samples_seen) {
+		printf("AVSYNC - no audio produced\n");
+		return;
+	}
+	printf("AVSYNC - offset now %.2fms, worst %.2fms at cycle %llu\n", offset_ms, worst_offset_ms, (unsigned long long)worst_offset_time);
+	printf("AVSYNC - worst resync error %.2fms, drift %.3fms/s (worst %.3fms/s)\n", worst_resync_ms, drift_ms_per_s, worst_drift_ms_per_s);
+}
+
+void SimAVSync::CleanUp() {
+	if (log) {
+		fclose(log);
+		log = NULL;
+	}
+}
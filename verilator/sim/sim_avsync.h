@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+
+// Audio/video synchronisation analyser
+// ------------------------------------
+// Timestamps every displayed frame and every block of audio in sim time and
+// compares where each stream is in the media. A search or skip resyncs both
+// streams to the target frame, the offset seen at the first frame shown after
+// it is the resync error for that search.
+struct SimAVSync {
+public:
+
+	// Results, all offsets are audio position minus video position in ms
+	unsigned int frames;
+	unsigned int audio_blocks;
+	unsigned int searches;
+	double offset_ms;	// at the last displayed frame
+	double worst_offset_ms;
+	uint64_t worst_offset_time;
+	double worst_resync_ms;
+	double drift_ms_per_s;	// offset slope since the last search
+	double worst_drift_ms_per_s;
+
+	SimAVSync(int systemClockFrequency, unsigned int fpks, int sampleRate);
+	~SimAVSync();
+
+	// Stream events, time is in sim clock cycles
+	void Search(int32_t frame, uint64_t time);
+	void SetSpeed(unsigned int numerator, unsigned int denominator);
+	void SetFrameRate(unsigned int fpks);	// from the stream's sequence header, 0 keeps the current rate
+	void FrameDisplayed(uint64_t time);
+	void FrameNumber(int32_t frame, uint64_t time);
+	void AudioClock(uint64_t samples, uint64_t time);
+
+	bool OpenLog(const char* fileName);
+	void Report();
+	void CleanUp();
+
+private:
+	double cycles_per_ms;
+	double frame_ms;
+	unsigned int frame_fpks;
+	double samples_per_ms;
+
+	// Position at the last search
+	int32_t search_frame;
+	uint64_t search_time;
+	uint64_t search_samples;
+	bool awaiting_first_frame;
+
+	// Video
+	double video_frame;	// media frame on screen
+	unsigned int speed_num, speed_den;
+
+	// Audio, positions are sampled at block boundaries
+	uint64_t block_samples;
+	uint64_t block_time;
+	uint64_t samples_seen;
+
+	// Least squares fit of offset against time since the last search
+	double fit_n, fit_t, fit_o, fit_tt, fit_to;
+
+	FILE* log;
+
+	void Measure(uint64_t time);
+};
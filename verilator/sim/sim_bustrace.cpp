@@ -0,0 +1,323 @@
+#include "sim_bustrace.h"
+#include <string.h>
+
+#define BUSTRACE_MASK 0xFFFFFFFFFULL	// the busses are 36 bits
+#define BUSTRACE_STROBE (1ULL << 33)
+#define BUSTRACE_IO_EN (1ULL << 34)
+#define BUSTRACE_FPGA_EN (1ULL << 35)
+
+static const char bustrace_magic[8] = { 'E', 'X', 'T', 'B', 'U', 'S', 0, 1 };
+
+// Lanes in mask bit order, the ones that change every bus word come first so the mask fits in one byte
+enum { LANE_IN, LANE_IO, LANE_OUT };
+static const struct { int bus; int shift; int bits; } bustrace_lanes[9] = {
+	{ LANE_IN, 16, 16 },	// io_din
+	{ LANE_IN, 32, 4 },	// io_strobe, io_enable, fp_enable
+	{ LANE_OUT, 0, 16 },	// io_dout
+	{ LANE_OUT, 32, 4 },	// dout_en
+	{ LANE_IO, 32, 4 },
+	{ LANE_IO, 0, 16 },
+	{ LANE_IO, 16, 16 },
+	{ LANE_IN, 0, 16 },
+	{ LANE_OUT, 16, 16 },
+};
+
+static void bustrace_put_varint(FILE* f, uint64_t v) {
+	while (v >= 0x80) {
+		putc((int)(v & 0x7F) | 0x80, f);
+		v >>= 7;
+	}
+	putc((int)v, f);
+}
+
+static bool bustrace_get_varint(FILE* f, uint64_t* v) {
+	*v = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		int c = getc(f);
+		if (c == EOF) { return false; }
+		*v |= (uint64_t)(c & 0x7F) << shift;
+		if (!(c & 0x80)) { return true; }
+	}
+	return false;
+}
+
+static uint16_t bustrace_lane(const uint64_t* busses, int lane) {
+	return (uint16_t)((busses[bustrace_lanes[lane].bus] >> bustrace_lanes[lane].shift) & ((1 << bustrace_lanes[lane].bits) - 1));
+}
+
+static const char* bustrace_command(bool fpga, uint16_t cmd) {
+	// user_io.h
+	if (!fpga) {
+		switch (cmd) {
+		case 0x34: return "CD_GET";
+		case 0x35: return "CD_SET";
+		}
+	}
+	else {
+		switch (cmd & 0xFF) {
+		case 0x53: return "FILE_TX";
+		case 0x54: return "FILE_TX_DAT";
+		case 0x55: return "FILE_INDEX";
+		case 0x56: return "FILE_INFO";
+		}
+	}
+	return "";
+}
+
+SimBusTrace::SimBusTrace() {
+	file = NULL;
+	name = NULL;
+	decode_out = NULL;
+	Reset();
+}
+
+SimBusTrace::~SimBusTrace() {
+	CleanUp();
+}
+
+void SimBusTrace::Reset() {
+	recording = false;
+	replaying = false;
+	finished = false;
+	bus = 0;
+	bus_in = 0;
+	records = 0;
+	transactions = 0;
+	words = 0;
+	mismatches = 0;
+	first_mismatch = -1;
+	in = io = out = 0;
+	state_cycle = 0;
+	cycle = 0;
+	started = false;
+	sample_in = sample_io = 0;
+	next_cycle = 0;
+	next_mask = 0;
+	in_transaction = false;
+	tr_words = 0;
+}
+
+bool SimBusTrace::Record(const char* fileName) {
+	CleanUp();
+	Reset();
+	file = fopen(fileName, "wb");
+	if (!file) {
+		printf("BUSTRACE - can't create %s\n", fileName);
+		return false;
+	}
+	setvbuf(file, NULL, _IOFBF, 1 << 20);
+	name = fileName;
+	recording = true;
+	return true;
+}
+
+bool SimBusTrace::Replay(const char* fileName) {
+	char magic[8];
+	uint64_t first = 0;
+
+	CleanUp();
+	Reset();
+	file = fopen(fileName, "rb");
+	if (!file) {
+		printf("BUSTRACE - can't open %s\n", fileName);
+		return false;
+	}
+	if (fread(magic, sizeof(magic), 1, file) != 1 || memcmp(magic, bustrace_magic, sizeof(magic)) || fread(&first, sizeof(first), 1, file) != 1) {
+		printf("BUSTRACE - %s isn't a bus trace\n", fileName);
+		fclose(file);
+		file = NULL;
+		return false;
+	}
+	setvbuf(file, NULL, _IOFBF, 1 << 20);
+	name = fileName;
+	replaying = true;
+	state_cycle = first;
+	next_cycle = first;
+	if (!ReadRecord()) { next_mask = 0; }
+	return true;
+}
+
+void SimBusTrace::BeforeEval(uint64_t cycle, uint64_t ext_bus, uint64_t ext_bus_in) {
+	if (!file) { return; }
+	this->cycle = cycle;
+	if (recording) {
+		sample_in = ext_bus_in & BUSTRACE_MASK;
+		sample_io = ext_bus & BUSTRACE_MASK;
+	}
+	if (replaying) {
+		Advance(cycle);
+		bus = io;
+		bus_in = in;
+	}
+}
+
+void SimBusTrace::AfterEval(uint64_t ext_bus_out) {
+	if (!file) { return; }
+	ext_bus_out &= BUSTRACE_MASK;
+	if (recording) {
+		if (!started) {
+			fwrite(bustrace_magic, sizeof(bustrace_magic), 1, file);
+			fwrite(&cycle, sizeof(cycle), 1, file);
+			started = true;
+			state_cycle = cycle;
+			in = ~sample_in;	// forces every lane into the first record
+			io = ~sample_io;
+			out = ~ext_bus_out;
+		}
+		if (sample_in != in || sample_io != io || ext_bus_out != out) {
+			uint64_t now[3] = { sample_in, sample_io, ext_bus_out };
+			uint64_t was[3] = { in, io, out };
+			uint32_t mask = 0;
+			for (int lane = 0; lane < 9; lane++) {
+				if (bustrace_lane(now, lane) != bustrace_lane(was, lane)) { mask |= 1 << lane; }
+			}
+
+			if (records) { Track(state_cycle, cycle - state_cycle); }
+			bustrace_put_varint(file, cycle - state_cycle);
+			bustrace_put_varint(file, mask);
+			for (int lane = 0; lane < 9; lane++) {
+				if (!(mask & (1 << lane))) { continue; }
+				uint16_t v = bustrace_lane(now, lane);
+				putc(v & 0xFF, file);
+				if (bustrace_lanes[lane].bits > 8) { putc(v >> 8, file); }
+			}
+			records++;
+
+			in = sample_in;
+			io = sample_io;
+			out = ext_bus_out;
+			state_cycle = cycle;
+		}
+	}
+	if (replaying && ext_bus_out != out) {
+		mismatches++;
+		if (first_mismatch < 0) { first_mismatch = (int64_t)cycle; }
+	}
+}
+
+// Reads the next record's timing and lanes, false at the end marker or a truncated file
+bool SimBusTrace::ReadRecord() {
+	uint64_t delta, mask;
+	if (!bustrace_get_varint(file, &delta) || !bustrace_get_varint(file, &mask)) { return false; }
+	next_cycle += delta;
+	next_mask = (uint32_t)mask;
+	if (!next_mask) { return false; }
+	for (int lane = 0; lane < 9; lane++) {
+		if (!(next_mask & (1 << lane))) { continue; }
+		int lo = getc(file);
+		int hi = (bustrace_lanes[lane].bits > 8) ? getc(file) : 0;
+		if (lo == EOF || hi == EOF) { return false; }
+		next_lanes[lane] = (uint16_t)(lo | (hi << 8));
+	}
+	return true;
+}
+
+// Applies every record up to and including cycle 'to'
+void SimBusTrace::Advance(uint64_t to) {
+	while (!finished && next_cycle <= to) {
+		if (records || !next_mask) { Track(state_cycle, next_cycle - state_cycle); }
+
+		// an empty mask is the end of the recording
+		if (!next_mask) {
+			EndTransaction();
+			finished = true;
+			break;
+		}
+
+		uint64_t* busses[3] = { &in, &io, &out };
+		for (int lane = 0; lane < 9; lane++) {
+			if (!(next_mask & (1 << lane))) { continue; }
+			uint64_t bits = ((1ULL << bustrace_lanes[lane].bits) - 1) << bustrace_lanes[lane].shift;
+			uint64_t* b = busses[bustrace_lanes[lane].bus];
+			*b = (*b & ~bits) | ((uint64_t)next_lanes[lane] << bustrace_lanes[lane].shift);
+		}
+		records++;
+		state_cycle = next_cycle;
+
+		if (!ReadRecord()) { next_mask = 0; }
+	}
+}
+
+// Feeds 'count' cycles of the current bus state, starting at 'from', to the transaction decoder
+void SimBusTrace::Track(uint64_t from, uint64_t count) {
+	uint64_t ctl = in | io;
+	bool enable = ctl & (BUSTRACE_IO_EN | BUSTRACE_FPGA_EN);
+
+	if (!count) { return; }
+	if (in_transaction && !enable) { EndTransaction(); }
+	if (!in_transaction && enable) {
+		in_transaction = true;
+		tr_fpga = !(ctl & BUSTRACE_IO_EN);
+		tr_cycle = from;
+		tr_words = 0;
+	}
+	if (in_transaction && (ctl & BUSTRACE_STROBE)) {
+		// io_strobe held high is a word every cycle (bursts)
+		for (uint64_t n = tr_words; n < 8 && n < tr_words + count; n++) {
+			tr_din[n] = (uint16_t)(in >> 16);
+			tr_dout[n] = (uint16_t)out;
+		}
+		tr_words += count;
+	}
+}
+
+void SimBusTrace::EndTransaction() {
+	if (!in_transaction) { return; }
+	in_transaction = false;
+	if (!tr_words) { return; }	// enable without any words
+	transactions++;
+	words += tr_words;
+
+	if (decode_out) {
+		fprintf(decode_out, "%12llu %s %04x %-11s %6llu words  in", (unsigned long long)tr_cycle, tr_fpga ? "FPGA" : "IO  ",
+			tr_din[0], bustrace_command(tr_fpga, tr_din[0]), (unsigned long long)tr_words);
+		for (uint64_t n = 1; n < 8 && n < tr_words; n++) { fprintf(decode_out, " %04x", tr_din[n]); }
+		if (tr_words > 8) { fprintf(decode_out, " ..."); }
+		fprintf(decode_out, "  out");
+		for (uint64_t n = 0; n < 8 && n < tr_words; n++) { fprintf(decode_out, " %04x", tr_dout[n]); }
+		fprintf(decode_out, "\n");
+	}
+}
+
+bool SimBusTrace::Decode(const char* fileName, FILE* out) {
+	if (!Replay(fileName)) { return false; }
+	decode_out = out;
+	fprintf(out, "%12s %-4s %-16s %12s\n", "cycle", "bus", "command", "length");
+	while (!finished) { Advance(next_cycle); }
+	EndTransaction();
+	fprintf(out, "%llu records, %llu transactions, %llu words, cycles %llu\n", (unsigned long long)records,
+		(unsigned long long)transactions, (unsigned long long)words, (unsigned long long)next_cycle);
+	decode_out = NULL;
+	CleanUp();
+	return true;
+}
+
+void SimBusTrace::Report() {
+	if (recording) {
+		printf("BUSTRACE - recorded %llu records, %llu transactions, %llu words to %s\n", (unsigned long long)records,
+			(unsigned long long)transactions, (unsigned long long)words, name);
+	}
+	if (replaying) {
+		printf("BUSTRACE - replayed %llu records, %llu transactions, %llu words from %s%s\n", (unsigned long long)records,
+			(unsigned long long)transactions, (unsigned long long)words, name, finished ? "" : " (not finished)");
+		if (mismatches) {
+			printf("BUSTRACE - EXT_BUS_OUT differed on %llu cycles, first at cycle %lld\n", (unsigned long long)mismatches, (long long)first_mismatch);
+		}
+		else {
+			printf("BUSTRACE - EXT_BUS_OUT matched the recording\n");
+		}
+	}
+}
+
+void SimBusTrace::CleanUp() {
+	if (!file) { return; }
+	if (recording && started) {
+		// end marker, the last state lasted up to and including this cycle
+		Track(state_cycle, cycle + 1 - state_cycle);
+		EndTransaction();
+		bustrace_put_varint(file, cycle + 1 - state_cycle);
+		bustrace_put_varint(file, 0);
+	}
+	fclose(file);
+	file = NULL;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+
+// EXT_BUS transaction recorder and replay driver
+// ----------------------------------------------
+// Records the HPS bus as the core sees it on every rising clk_sys edge:
+// EXT_BUS_IN and EXT_BUS going in, EXT_BUS_OUT coming back. Only changes are
+// written, so a trace is a few bytes per bus word. Replaying drives the
+// recorded HPS side straight into the RTL without running daphne.cpp and
+// checks EXT_BUS_OUT against what the core answered when it was recorded.
+//
+// File format, little endian:
+//   "EXTBUS" 0 1       magic and version
+//   u64                cycle of the first record
+//   records            varint cycles since the previous record, varint lane
+//                      mask, then the new value of every lane in the mask
+// A record with an empty mask marks the end of the recording.
+struct SimBusTrace {
+public:
+	bool recording;
+	bool replaying;
+	bool finished;	// replay has passed the end of the recording
+
+	// Replay: drive these into EXT_BUS and EXT_BUS_IN after BeforeEval
+	uint64_t bus;
+	uint64_t bus_in;
+
+	// Results
+	uint64_t records;
+	uint64_t transactions;
+	uint64_t words;
+	uint64_t mismatches;	// replay: cycles where EXT_BUS_OUT differed from the recording
+	int64_t first_mismatch;	// cycle of the first one, -1 if none
+
+	SimBusTrace();
+	~SimBusTrace();
+
+	bool Record(const char* fileName);
+	bool Replay(const char* fileName);
+
+	// Around the rising clk_sys eval
+	void BeforeEval(uint64_t cycle, uint64_t ext_bus, uint64_t ext_bus_in);
+	void AfterEval(uint64_t ext_bus_out);
+
+	// Prints one line per transaction (command, length, first payload words) of a trace
+	bool Decode(const char* fileName, FILE* out);
+
+	void Report();
+	void CleanUp();
+
+private:
+	FILE* file;
+	const char* name;
+
+	// Bus state, and the cycle it has held since
+	uint64_t in, io, out;
+	uint64_t state_cycle;
+	uint64_t cycle;
+	bool started;
+
+	// Recording: inputs sampled before the eval
+	uint64_t sample_in, sample_io;
+
+	// Replay: next record, already read
+	uint64_t next_cycle;
+	uint32_t next_mask;
+	uint16_t next_lanes[9];
+
+	// Transaction being decoded
+	bool in_transaction;
+	bool tr_fpga;
+	uint64_t tr_cycle;
+	uint64_t tr_words;
+	uint16_t tr_din[8];
+	uint16_t tr_dout[8];
+	FILE* decode_out;
+
+	void Reset();
+	bool ReadRecord();
+	void Advance(uint64_t to);
+	void Track(uint64_t from, uint64_t count);
+	void EndTransaction();
+};
@@ -1,11 +1,15 @@
 #include "sim_clock.h"
 #include <string>
+#include <stdio.h>
 
 SimClock::SimClock() {
 	ratio = 1;
 	count = 0;
 	clk = false;
 	old = false;
+	freq = 0;
+	phase = 0;
+	half = next = 0;
 }
 
 SimClock::SimClock(int r) {
@@ -13,6 +17,19 @@ SimClock::SimClock(int r) {
 	count = 0;
 	clk = false;
 	old = false;
+	freq = 0;
+	phase = 0;
+	half = next = 0;
+}
+
+SimClock::SimClock(uint64_t hz, int phase_deg) {
+	ratio = 1;
+	count = 0;
+	clk = false;
+	old = false;
+	freq = hz;
+	phase = ((phase_deg % 360) + 360) % 360;
+	half = next = 0;
 }
 
 
@@ -37,3 +54,111 @@ void SimClock::Reset() {
 bool SimClock::IsRising() {
 	return clk && !old;
 }
+
+static uint64_t clock_gcd(uint64_t a, uint64_t b) {
+	while (b) {
+		uint64_t t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+SimClockScheduler::SimClockScheduler() {
+	time = 0;
+	ticks_per_second = 0;
+}
+
+SimClockScheduler::~SimClockScheduler() {
+}
+
+bool SimClockScheduler::Add(SimClock* clock) {
+	if (!clock->freq) {
+		printf("CLOCK - scheduled clocks need a frequency\n");
+		return false;
+	}
+	clocks.push_back(clock);
+	Reset();
+	return true;
+}
+
+void SimClockScheduler::Reset() {
+	uint64_t base = 1;
+	for (SimClock* c : clocks) { base = base / clock_gcd(base, c->freq) * c->freq; }
+	if (base > 10000000000000ULL) {
+		// 3.6e15 ticks/s still gives over an hour of simulated time before the 64 bit counter wraps
+		printf("CLOCK - frequencies have no useful common base (%llu Hz)\n", (unsigned long long)base);
+	}
+	ticks_per_second = 360 * base;
+	time = 0;
+
+	// edges at phase + n * half: the first one is rising
+	for (SimClock* c : clocks) {
+		c->Reset();
+		c->half = 180 * (base / c->freq);
+		c->next = (uint64_t)c->phase * (base / c->freq);
+	}
+}
+
+int SimClockScheduler::Advance() {
+	uint64_t edge = UINT64_MAX;
+	int changed = 0;
+
+	for (SimClock* c : clocks) {
+		if (c->next < edge) { edge = c->next; }
+	}
+	time = edge;
+	for (SimClock* c : clocks) {
+		c->old = c->clk;
+		if (c->next == edge) {
+			c->clk = !c->clk;
+			c->next += c->half;
+			changed++;
+		}
+	}
+	return changed;
+}
+
+double SimClockScheduler::Seconds() {
+	return ticks_per_second ? (double)time / ticks_per_second : 0;
+}
+
+SimClockEvents::SimClockEvents() {
+	due = UINT64_MAX;
+}
+
+SimClockEvents::~SimClockEvents() {
+}
+
+void SimClockEvents::Add(SimClockCallback callback, uint64_t start, uint64_t period) {
+	Event e = { callback, start, period, start, true };
+	events.push_back(e);
+	Schedule();
+}
+
+void SimClockEvents::Reset() {
+	for (Event& e : events) {
+		e.next = e.start;
+		e.active = true;
+	}
+	Schedule();
+}
+
+void SimClockEvents::Dispatch(uint64_t cycle) {
+	// callbacks can run the core (daphne_poll does), nothing is dispatched from inside one
+	due = UINT64_MAX;
+	for (size_t i = 0; i < events.size(); i++) {
+		if (!events[i].active || events[i].next > cycle) { continue; }
+		events[i].active = events[i].period != 0;
+		events[i].next = cycle + events[i].period;
+		if (!events[i].callback()) { events[i].active = false; }
+	}
+	Schedule();
+}
+
+void SimClockEvents::Schedule() {
+	due = UINT64_MAX;
+	for (const Event& e : events) {
+		if (e.active && e.next < due) { due = e.next; }
+	}
+}
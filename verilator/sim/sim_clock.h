@@ -1,5 +1,8 @@
 #pragma once
 
+#include <stdint.h>
+#include <vector>
+
 class SimClock
 {
 
@@ -8,6 +11,7 @@ public:
 
 	SimClock();
 	SimClock(int r);
+	SimClock(uint64_t hz, int phase_deg);	// for SimClockScheduler
 	~SimClock();
 	void Tick();
 	void Reset();
@@ -15,4 +19,60 @@ public:
 
 private:
 	int ratio, count;
-};
\ No newline at end of file
+
+	// Scheduled clocks: frequency, phase and the time of the next edge in scheduler ticks
+	uint64_t freq;
+	int phase;
+	uint64_t half, next;
+
+	friend class SimClockScheduler;
+};
+
+// Runs several SimClocks at their real frequencies and phases. Time is kept in
+// integer ticks of 1 / (360 * lcm(frequencies)) s, so every edge lands exactly
+// on a tick and Advance() goes straight from one edge to the next.
+class SimClockScheduler
+{
+
+public:
+	uint64_t time;	// ticks since Reset
+	uint64_t ticks_per_second;
+
+	SimClockScheduler();
+	~SimClockScheduler();
+	bool Add(SimClock* clock);
+	void Reset();
+	int Advance();	// moves to the next edge of any clock, returns how many clocks changed
+	double Seconds();
+
+private:
+	std::vector<SimClock*> clocks;
+};
+
+// Harness work tied to clk_sys cycles rather than done on every verilate() call.
+// A callback runs at cycle 'start' and then every 'period' cycles (once if the
+// period is 0) until it returns false.
+typedef bool (*SimClockCallback)();
+
+class SimClockEvents
+{
+
+public:
+	SimClockEvents();
+	~SimClockEvents();
+	void Add(SimClockCallback callback, uint64_t start, uint64_t period);
+	void Reset();	// re-arms every callback from its start
+	void Run(uint64_t cycle) { if (cycle >= due) { Dispatch(cycle); } }
+
+private:
+	struct Event {
+		SimClockCallback callback;
+		uint64_t start, period, next;
+		bool active;
+	};
+	std::vector<Event> events;
+	uint64_t due;	// earliest next of any active event
+
+	void Dispatch(uint64_t cycle);
+	void Schedule();
+};
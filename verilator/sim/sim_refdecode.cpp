@@ -0,0 +1,278 @@
+#include "sim_refdecode.h"
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+
+#include "../../cpp/Main_MiSTer/support/daphne_lib.h"
+
+#ifdef SIM_REFDECODE
+#include <inttypes.h>
+extern "C" {
+#include <mpeg2dec/mpeg2.h>
+}
+
+#define REF_READ_SIZE (64 * 1024)	// also the most we look through for the first GOP
+
+FILE* ref_file = NULL;
+mpeg2dec_t* ref_mpeg = NULL;
+uint8_t ref_buf[REF_READ_SIZE];
+uint32_t ref_drop;	// pictures still to decode and throw away after the I frame
+
+// Reference picture after colour conversion, 0x00BBGGRR like the sim output
+std::vector<uint32_t> ref_rgb;
+
+// ITU-R BT.601 studio swing to RGB, the conversion mpeg2fpga's yuv2rgb does,
+// chroma is repeated across each 2x2 block
+static uint8_t clip8(int v) {
+	return (v < 0) ? 0 : ((v > 255) ? 255 : v);
+}
+
+static void convertPicture(const mpeg2_info_t* info) {
+	int w = info->sequence->width;
+	int h = info->sequence->height;
+	int cw = info->sequence->chroma_width;
+	int ch = info->sequence->chroma_height;
+	uint8_t* const* buf = info->display_fbuf->buf;
+
+	ref_rgb.resize(w * h);
+	for (int y = 0; y < h; y++) {
+		const uint8_t* py = buf[0] + (y * w);
+		const uint8_t* pu = buf[1] + (((y * ch) / h) * cw);
+		const uint8_t* pv = buf[2] + (((y * ch) / h) * cw);
+		uint32_t* out = &ref_rgb[y * w];
+		for (int x = 0; x < w; x++) {
+			int c = 298 * (py[x] - 16);
+			int d = pu[(x * cw) / w] - 128;
+			int e = pv[(x * cw) / w] - 128;
+			uint8_t r = clip8((c + (409 * e) + 128) >> 8);
+			uint8_t g = clip8((c - (100 * d) - (208 * e) + 128) >> 8);
+			uint8_t b = clip8((c + (516 * d) + 128) >> 8);
+			out[x] = (b << 16) | (g << 8) | r;
+		}
+	}
+}
+#endif
+
+SimRefDecoder::SimRefDecoder() {
+	origin_x = 0;
+	origin_y = 0;
+	tolerance = 2;
+	map_prefix = NULL;
+	width = 0;
+	height = 0;
+	frames_compared = 0;
+	psnr = 0;
+	psnr_min = 0;
+	psnr_min_frame = -1;
+	mismatches = 0;
+	mismatch_frames = 0;
+	log = NULL;
+	active = false;
+	waiting = false;
+}
+
+SimRefDecoder::~SimRefDecoder() {
+}
+
+// Positions the decoder the way VLDP does for a search: replay the sequence
+// header from the start of the file, then decode from the chosen I frame and
+// drop the pictures before the target.
+bool SimRefDecoder::Seek(int32_t frame) {
+#ifdef SIM_REFDECODE
+	daphne_location loc;
+	active = false;
+	if (!daphne_lib_locate(frame, &loc)) { return false; }
+
+	if (ref_file) { fclose(ref_file); }
+	ref_file = fopen(daphne_lib_segment_path(loc.segment), "rb");
+	if (!ref_file) {
+		printf("SimRefDecoder: unable to open %s\n", daphne_lib_segment_path(loc.segment));
+		return false;
+	}
+	if (!ref_mpeg) { ref_mpeg = mpeg2_init(); }
+	mpeg2_reset(ref_mpeg, 0);
+
+	// Everything before the first GOP, same as vldp_cache_sequence_header
+	size_t got = fread(ref_buf, 1, REF_READ_SIZE, ref_file);
+	uint32_t val = 0xFFFFFFFF;
+	size_t header = 0;
+	while (header < got && val != 0x000001B8) {
+		val = (val << 8) | ref_buf[header++];
+	}
+	if (val != 0x000001B8) {
+		printf("SimRefDecoder: no GOP header in the first %d bytes\n", (int)got);
+		return false;
+	}
+	mpeg2_buffer(ref_mpeg, ref_buf, ref_buf + header - 4);
+	while (mpeg2_parse(ref_mpeg) != STATE_BUFFER) {}
+
+	fseeko(ref_file, loc.offset, SEEK_SET);
+	ref_drop = loc.skip;
+	active = true;
+	waiting = true;
+	return true;
+#else
+	printf("SimRefDecoder: not built in, rebuild with REFDECODE=y\n");
+	return false;
+#endif
+}
+
+// Decodes until the next displayed picture lands in ref_rgb
+bool SimRefDecoder::NextPicture() {
+#ifdef SIM_REFDECODE
+	const mpeg2_info_t* info = mpeg2_info(ref_mpeg);
+	for (;;) {
+		mpeg2_state_t state = mpeg2_parse(ref_mpeg);
+		switch (state) {
+		case STATE_BUFFER: {
+			size_t got = fread(ref_buf, 1, REF_READ_SIZE, ref_file);
+			if (!got) { return false; }
+			mpeg2_buffer(ref_mpeg, ref_buf, ref_buf + got);
+			break;
+		}
+		case STATE_SLICE:
+		case STATE_END:
+		case STATE_INVALID_END:
+			if (info->display_fbuf) {
+				if (ref_drop) {
+					ref_drop--;
+					break;
+				}
+				width = info->sequence->width;
+				height = info->sequence->height;
+				convertPicture(info);
+				return true;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+#else
+	return false;
+#endif
+}
+
+// Compares the frame the sim just completed against the next reference picture
+void SimRefDecoder::Compare(const uint32_t* pixels, int stride, int rows, int frame) {
+#ifdef SIM_REFDECODE
+	if (!active) { return; }
+
+	// The decoder takes a few frames to show anything after a seek, start
+	// comparing at the first frame that isn't a flat fill
+	if (waiting) {
+		const uint32_t* p = pixels + (origin_y * stride) + origin_x;
+		bool flat = true;
+		for (int y = 0; y < rows - origin_y && flat; y += 8) {
+			for (int x = 0; x < stride - origin_x; x += 8) {
+				if ((p[(y * stride) + x] ^ p[0]) & 0xFFFFFF) { flat = false; break; }
+			}
+		}
+		if (flat) { return; }
+		waiting = false;
+	}
+
+	if (!NextPicture()) {
+		printf("SimRefDecoder: reference stream ended at sim frame %d\n", frame);
+		active = false;
+		return;
+	}
+
+	// PSNR over the RGB channels of the area both pictures cover
+	int w = (width < stride - origin_x) ? width : stride - origin_x;
+	int h = (height < rows - origin_y) ? height : rows - origin_y;
+	double sse = 0;
+	mismatches = 0;
+	for (int y = 0; y < h; y++) {
+		const uint32_t* sim = pixels + ((origin_y + y) * stride) + origin_x;
+		const uint32_t* ref = &ref_rgb[y * width];
+		for (int x = 0; x < w; x++) {
+			bool bad = false;
+			for (int c = 0; c < 24; c += 8) {
+				int d = (int)((sim[x] >> c) & 0xFF) - (int)((ref[x] >> c) & 0xFF);
+				sse += d * d;
+				if (abs(d) > tolerance) { bad = true; }
+			}
+			if (bad) { mismatches++; }
+		}
+	}
+	double mse = sse / ((double)w * h * 3);
+	psnr = (mse > 0) ? 10.0 * log10((255.0 * 255.0) / mse) : 99.99;
+
+	if (!frames_compared || psnr < psnr_min) {
+		psnr_min = psnr;
+		psnr_min_frame = frame;
+	}
+	frames_compared++;
+	if (mismatches) {
+		mismatch_frames++;
+		if (map_prefix) { WriteMap(pixels, stride, frame); }
+	}
+	if (log) { fprintf(log, "%d,%.2f,%d\n", frame, psnr, mismatches); }
+#endif
+}
+
+// Mismatch map: reference picture dimmed, pixels beyond tolerance in red
+void SimRefDecoder::WriteMap(const uint32_t* pixels, int stride, int frame) {
+#ifdef SIM_REFDECODE
+	char name[1024];
+	snprintf(name, sizeof(name), "%s%05d.ppm", map_prefix, frame);
+	FILE* f = fopen(name, "wb");
+	if (!f) { return; }
+	fprintf(f, "P6\n%d %d\n255\n", width, height);
+	std::vector<uint8_t> row(width * 3);
+	for (int y = 0; y < height; y++) {
+		const uint32_t* sim = pixels + ((origin_y + y) * stride) + origin_x;
+		for (int x = 0; x < width; x++) {
+			uint32_t ref = ref_rgb[(y * width) + x];
+			bool bad = false;
+			if (x < stride - origin_x) {
+				for (int c = 0; c < 24; c += 8) {
+					if (abs((int)((sim[x] >> c) & 0xFF) - (int)((ref >> c) & 0xFF)) > tolerance) { bad = true; }
+				}
+			}
+			row[x * 3] = bad ? 255 : (ref & 0xFF) / 4;
+			row[(x * 3) + 1] = bad ? 0 : ((ref >> 8) & 0xFF) / 4;
+			row[(x * 3) + 2] = bad ? 0 : ((ref >> 16) & 0xFF) / 4;
+		}
+		fwrite(row.data(), 1, row.size(), f);
+	}
+	fclose(f);
+#endif
+}
+
+bool SimRefDecoder::OpenLog(const char* fileName) {
+	log = fopen(fileName, "w");
+	if (!log) {
+		printf("SimRefDecoder: unable to open %s\n", fileName);
+		return false;
+	}
+	fprintf(log, "frame,psnr,mismatches\n");
+	return true;
+}
+
+void SimRefDecoder::Report() {
+	printf("REFDECODE - %d frames compared, %d with mismatches\n", frames_compared, mismatch_frames);
+	if (frames_compared) {
+		printf("REFDECODE - last frame %.2fdB, worst %.2fdB at sim frame %d\n", psnr, psnr_min, psnr_min_frame);
+	}
+}
+
+void SimRefDecoder::CleanUp() {
+#ifdef SIM_REFDECODE
+	if (ref_mpeg) {
+		mpeg2_close(ref_mpeg);
+		ref_mpeg = NULL;
+	}
+	if (ref_file) {
+		fclose(ref_file);
+		ref_file = NULL;
+	}
+#endif
+	if (log) {
+		fclose(log);
+		log = NULL;
+	}
+	active = false;
+}
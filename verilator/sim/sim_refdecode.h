@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+
+// Software reference decoder
+// --------------------------
+// Decodes the same m2v the harness streams with libmpeg2, starting at the
+// I frame VLDP would seek to, and compares each picture with what the RTL
+// put in the SimVideo buffer. Build with REFDECODE=y to enable it.
+struct SimRefDecoder {
+public:
+
+	// Settings
+	int origin_x, origin_y;	// where the picture starts in the SimVideo buffer
+	int tolerance;	// per channel difference still counted as a match
+	const char* map_prefix;	// write <prefix><frame>.ppm for frames with mismatches, NULL to skip
+
+	// Results
+	int width, height;	// decoded picture size
+	int frames_compared;
+	double psnr;	// last frame, in dB
+	double psnr_min;
+	int psnr_min_frame;
+	int mismatches;	// pixels beyond tolerance in the last frame
+	int mismatch_frames;
+
+	SimRefDecoder();
+	~SimRefDecoder();
+
+	bool Seek(int32_t frame);
+	void Compare(const uint32_t* pixels, int stride, int rows, int frame);
+	bool OpenLog(const char* fileName);
+	void Report();
+	void CleanUp();
+
+private:
+	FILE* log;
+	bool active;
+	bool waiting;	// sim hasn't shown a picture since the seek
+
+	bool NextPicture();
+	void WriteMap(const uint32_t* pixels, int stride, int frame);
+};
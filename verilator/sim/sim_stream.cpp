@@ -0,0 +1,142 @@
+#include "sim_stream.h"
+#include "../../cpp/Main_MiSTer/support/daphne_lib.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _MSC_VER
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// Sequence end codes served after the file, enough to flush the decoder's input FIFO (was end-of-sequence.mpg)
+static const uint8_t stream_sequence_end[4] = { 0x00, 0x00, 0x01, 0xB7 };
+#define STREAM_END_CODES 64
+
+// The stream vldp.sv reads through the DPI, only one can be open
+static SimStream* stream_dpi = NULL;
+
+int sim_stream_byte() {
+	if (!stream_dpi) { return -2; }
+	stream_dpi->requests++;
+	int next = stream_dpi->Next();
+	if (next < 0) { stream_dpi->starved++; }
+	return next;
+}
+
+SimStream::SimStream() {
+	loop = false;
+	data = NULL;
+	name = NULL;
+	mapped = false;
+	CleanUp();
+}
+
+SimStream::~SimStream() {
+	CleanUp();
+}
+
+bool SimStream::Open(const char* fileName) {
+	CleanUp();
+
+#ifndef _MSC_VER
+	int fd = open(fileName, O_RDONLY);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st) < 0) {
+		printf("STREAM - can't open %s\n", fileName);
+		if (fd >= 0) { close(fd); }
+		return false;
+	}
+	size = (uint64_t)st.st_size;
+	if (size) {
+		void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map == MAP_FAILED) {
+			printf("STREAM - can't map %s\n", fileName);
+			close(fd);
+			return false;
+		}
+		madvise(map, size, MADV_SEQUENTIAL);
+		data = (const uint8_t*)map;
+		mapped = true;
+	}
+	close(fd);
+#else
+	FILE* f = fopen(fileName, "rb");
+	if (!f) {
+		printf("STREAM - can't open %s\n", fileName);
+		return false;
+	}
+	fseek(f, 0, SEEK_END);
+	size = (uint64_t)_ftelli64(f);
+	fseek(f, 0, SEEK_SET);
+	uint8_t* buffer = (uint8_t*)malloc(size ? size : 1);
+	if (!buffer || fread(buffer, 1, size, f) != size) {
+		printf("STREAM - can't read %s\n", fileName);
+		free(buffer);
+		fclose(f);
+		return false;
+	}
+	fclose(f);
+	data = buffer;
+#endif
+
+	name = fileName;
+	fpks = daphne_lib_sequence_fpks(data, size < 4096 ? (int)size : 4096);
+	tail = loop ? 0 : STREAM_END_CODES * sizeof(stream_sequence_end);
+	stream_dpi = this;
+	printf("STREAM - %s, %llu bytes\n", fileName, (unsigned long long)size);
+	return true;
+}
+
+int SimStream::Next() {
+	if (pos < size) {
+		bytes_served++;
+		code = (code << 8) | data[pos];
+		if (code == 0x00000100) { pictures++; }
+		return data[pos++];
+	}
+	if (tail) {
+		bytes_served++;
+		return stream_sequence_end[(STREAM_END_CODES * sizeof(stream_sequence_end) - tail--) & 3];
+	}
+	if (loop && size) {
+		pos = 0;
+		loops++;
+		return Next();
+	}
+	finished = true;
+	return -1;
+}
+
+void SimStream::Report() {
+	if (!name) { return; }
+	printf("STREAM - %llu of %llu bytes, %llu pictures served from %s", (unsigned long long)bytes_served, (unsigned long long)size, (unsigned long long)pictures, name);
+	if (loops) { printf(", looped %u times", loops); }
+	printf("%s\n", finished ? ", finished" : "");
+}
+
+void SimStream::CleanUp() {
+	if (data) {
+#ifndef _MSC_VER
+		if (mapped) { munmap((void*)data, size); }
+#else
+		free((void*)data);
+#endif
+	}
+	if (stream_dpi == this) { stream_dpi = NULL; }
+	data = NULL;
+	name = NULL;
+	mapped = false;
+	size = 0;
+	pos = 0;
+	tail = 0;
+	bytes_served = 0;
+	pictures = 0;
+	requests = 0;
+	starved = 0;
+	code = 0xFFFFFFFF;
+	loops = 0;
+	fpks = 0;
+	finished = false;
+}
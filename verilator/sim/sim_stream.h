@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+
+// Binary MPEG stream source
+// -------------------------
+// Maps an m2v file and hands it to the decoder a byte at a time through the
+// sim_stream_byte() DPI function vldp.sv calls whenever the decoder isn't
+// busy. Replaces the old stream.dat flow: any size of file, no conversion
+// and nothing baked into the RTL. Sequence end codes follow the last byte,
+// as end-of-sequence.mpg did, unless the stream loops.
+struct SimStream {
+public:
+
+	// Settings
+	bool loop;	// start again from the beginning instead of ending
+
+	// Results
+	uint64_t size;
+	uint64_t bytes_served;
+	uint64_t pictures;	// picture start codes served
+	uint64_t requests;	// cycles the decoder could take a byte
+	uint64_t starved;	// of those, how many found the stream finished
+	uint32_t loops;
+	unsigned int fpks;	// frame rate from the sequence header, 0 if the file has none
+	bool finished;	// every byte, and the sequence end codes, have been served
+
+	SimStream();
+	~SimStream();
+
+	bool Open(const char* fileName);
+	int Next();	// next byte, -1 once finished
+	void Report();
+	void CleanUp();
+
+private:
+	const uint8_t* data;
+	const char* name;
+	uint64_t pos;
+	int tail;	// bytes of the trailing sequence end codes still to serve
+	uint32_t code;	// last bytes served, to spot start codes
+	bool mapped;
+};
+
+// DPI-C, called from vldp.sv: the next byte, -1 if the stream has run out,
+// -2 if no stream is open and the HPS side feeds the decoder instead
+extern "C" int sim_stream_byte();
@@ -2,6 +2,10 @@
 #include "sim_video.h"
 
 #include <string>
+#include <vector>
+#include <map>
+#include <stdio.h>
+#include <string.h>
 
 #ifndef _MSC_VER
 #include "imgui_impl_sdl.h"
@@ -68,6 +72,25 @@ int stats_yMax;
 int stats_xMin;
 int stats_yMin;
 
+// Golden-frame hashing
+// --------------------
+// Every completed frame is hashed at the vsync edge and logged as
+// "<frame> <hash>". When a reference log is loaded the run is compared as it
+// goes and hash_mismatch_frame is set at the first frame that differs.
+// Frames missing from the reference (a log with gaps) aren't checked.
+FILE* hash_log = NULL;
+std::map<int, uint64_t> hash_reference;
+
+// FNV-1a over whole pixels, the buffer is ~2.7MB so this keeps up with the sim easily
+static uint64_t hashFrame(const uint32_t* pixels, unsigned int count) {
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (unsigned int i = 0; i < count; i++) {
+		hash ^= pixels[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
 
 #ifndef WIN32
 SDL_Renderer* renderer = NULL;
@@ -198,6 +221,13 @@ SimVideo::SimVideo(int width, int height, int rotate)
 	stats_yMax = -1000;
 	stats_xMin = 1000;
 	stats_yMin = 1000;
+
+	hash_frames = 0;
+	frame_hash = 0;
+	hash_mismatch_frame = -1;
+	hash_reference_frames = 0;
+	hash_checked_frames = 0;
+	frame_callback = NULL;
 }
 
 SimVideo::~SimVideo()
@@ -366,6 +396,50 @@ void SimVideo::UpdateTexture() {
 
 }
 
+// Output buffer only, for headless runs that hash frames without a window
+void SimVideo::InitialiseHeadless() {
+	output_ptr = (uint32_t*)malloc(output_size);
+	memset(output_ptr, 0, output_size);
+}
+
+bool SimVideo::OpenHashLog(const char* logFile, const char* referenceFile) {
+	if (referenceFile) {
+		FILE* ref = fopen(referenceFile, "r");
+		if (!ref) {
+			printf("SimVideo: unable to open reference %s\n", referenceFile);
+			return false;
+		}
+		int frame;
+		unsigned long long hash;
+		hash_reference.clear();
+		while (fscanf(ref, "%d %llx", &frame, &hash) == 2) {
+			if (frame < 0) { continue; }
+			hash_reference[frame] = hash;
+		}
+		fclose(ref);
+		hash_reference_frames = (int)hash_reference.size();
+	}
+	if (logFile) {
+		hash_log = fopen(logFile, "w");
+		if (!hash_log) {
+			printf("SimVideo: unable to open %s\n", logFile);
+			return false;
+		}
+	}
+	hash_frames = 1;
+	hash_mismatch_frame = -1;
+	hash_checked_frames = 0;
+	return true;
+}
+
+void SimVideo::CloseHashLog() {
+	if (hash_log) {
+		fclose(hash_log);
+		hash_log = NULL;
+	}
+	hash_frames = 0;
+}
+
 void SimVideo::CleanUp() {
 #ifdef WIN32
 	// Close imgui stuff properly...
@@ -420,6 +494,16 @@ void SimVideo::Clock(bool hblank, bool vblank, bool hsync, bool vsync, uint32_t
 
 	// Reset on rising vsync
 	if (last_vsync && !vsync) {
+		if (hash_frames) {
+			frame_hash = hashFrame(output_ptr, output_width * output_height);
+			if (hash_log) { fprintf(hash_log, "%d %016llx\n", count_frame, (unsigned long long)frame_hash); }
+			auto reference = hash_reference.find(count_frame);
+			if (reference != hash_reference.end()) {
+				hash_checked_frames++;
+				if (hash_mismatch_frame < 0 && reference->second != frame_hash) { hash_mismatch_frame = count_frame; }
+			}
+		}
+		if (frame_callback) { frame_callback(output_ptr, output_width, output_height, count_frame); }
 		frame_ready = 1;
 		count_frame++;
 		count_line = 0;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <stdint.h>
 #ifndef _MSC_VER
 #include "imgui_impl_sdl.h"
 #include "imgui_impl_opengl2.h"
@@ -33,6 +34,16 @@ public:
 
 	ImTextureID texture_id;
 
+	// Golden-frame hashing
+	bool hash_frames;
+	uint64_t frame_hash;	// hash of the last completed frame
+	int hash_mismatch_frame;	// first frame that differed from the reference, -1 if none
+	int hash_reference_frames;	// frames in the reference
+	int hash_checked_frames;	// frames the run has compared against it
+
+	// Called with the output buffer every time a frame completes
+	void (*frame_callback)(const uint32_t* pixels, int width, int height, int frame);
+
 	SimVideo(int width, int height, int rotate);
 	~SimVideo();
 	void UpdateTexture();
@@ -40,4 +51,7 @@ public:
 	void StartFrame();
 	void Clock(bool hblank, bool vblank, bool hsync, bool vsync, uint32_t colour);
 	int Initialise(const char* windowTitle);
+	void InitialiseHeadless();
+	bool OpenHashLog(const char* logFile, const char* referenceFile);
+	void CloseHashLog();
 };
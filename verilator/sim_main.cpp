@@ -17,6 +17,10 @@
 #include "sim_bus.h"
 #include "sim_video.h"
 #include "sim_audio.h"
+#include "sim_avsync.h"
+#include "sim_refdecode.h"
+#include "sim_bustrace.h"
+#include "sim_stream.h"
 #include "sim_input.h"
 #include "sim_clock.h"
 
@@ -25,9 +29,15 @@
 
 // Include Main_MiSTer-side files required for simulation
 #include "../../cpp/Main_MiSTer/support/daphne.h"
+#include "../../cpp/Main_MiSTer/support/daphne_lib.h"
+#include "../../cpp/Main_MiSTer/spi.h"
 
 #include <iostream>
 #include <fstream>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
 using namespace std;
 
 // Simulation control
@@ -40,6 +50,15 @@ int batchSize = 150000;
 bool single_step = 0;
 bool multi_step = 1;
 int multi_step_amount = 1024;
+vluint64_t headless_cycles = 0;	// run without UI for this many cycles (--headless)
+const char* frame_hash_log = NULL;	// --frame-hash-log, per-frame hashes of a headless run
+const char* frame_hash_golden = NULL;	// --golden, reference to compare them against
+const char* ref_decode_log = NULL;	// --ref-decode, compare frames with the software decoder
+const char* bus_record = NULL;	// --bus-record, capture the HPS bus traffic of a run
+const char* bus_replay = NULL;	// --bus-replay, drive the HPS bus from a capture instead of daphne.cpp
+const char* stream_file = NULL;	// --stream, feed the decoder from an m2v instead of the HPS side
+bool decoder_only = 0;	// --decoder-only, leave daphne.cpp out and time the decoder on the --stream file alone
+vluint64_t decoder_drain_cycles = 0;	// --drain-cycles, how long to wait for the decoder once the stream has run out
 
 // Debug GUI 
 // ---------
@@ -94,7 +113,7 @@ double sc_time_stamp() {	// Called by $time in Verilog.
 	return main_time;
 }
 
-vluint64_t stream_dat_count = 0;	// count in stream.dat
+vluint64_t stream_dat_count = 0;	// bytes the decoder has taken
 vluint64_t testpoint = 0;
 vluint64_t EXT_BUS = 0;
 vluint64_t EXT_BUS_IN = 0;
@@ -103,15 +122,80 @@ vluint64_t EXT_BUS_OUT = 0;
 //vluint64_t incoming_command_byte_count = 0;
 
 int clk_sys_freq = 100000000;
+#ifdef SIM_CLOCK_DOMAINS
+// mem_clk, sys_clk and dot_clk at their own rates instead of sim.v's divider
+SimClock clk_sys(clk_sys_freq, 0);
+SimClock clk_50(50000000, 0);
+SimClock clk_vid(25000000, 0);
+SimClockScheduler clocks;
+#else
 SimClock clk_sys(1);
+#endif
 
 // Audio
 // -----
-#define DISABLE_AUDIO
+//#define DISABLE_AUDIO
 #ifndef DISABLE_AUDIO
 SimAudio audio(clk_sys_freq, false);
 #endif
 
+// Reference decoder
+// -----------------
+SimRefDecoder refdec;
+uint32_t refdec_seeks = 0;
+
+void refdecFrame(const uint32_t* pixels, int width, int height, int frame) {
+	// Follow the seeks the HPS side makes so both decoders start at the same I frame
+	const daphne_stream_stats* stats = daphne_get_stats();
+	if (stats->seeks != refdec_seeks) {
+		refdec_seeks = stats->seeks;
+		refdec.Seek(stats->seek_frame);
+	}
+	refdec.Compare(pixels, width, height, frame);
+}
+
+// HPS bus recorder
+// ----------------
+SimBusTrace bustrace;
+
+// MPEG stream source
+// ------------------
+SimStream stream;
+vluint64_t stream_start = 0;	// cycle the decoder first asked for a byte
+vluint64_t stream_frames = 0;	// frames displayed while the stream was playing
+bool stream_vsync = 0;
+
+// Draining: after the stream runs out the decoder still has a picture or two to show
+#define STREAM_DRAIN_FRAMES 3	// whole frames without busy or a new picture before it counts as drained
+vluint64_t stream_finish = 0;	// cycle the last byte was served
+vluint64_t stream_pixels = 0;	// hash of the frame being displayed
+vluint64_t stream_frame_hash = 0;	// and of the one before
+vluint64_t stream_frame_start = 0;
+vluint64_t stream_frame_requests = 0;
+vluint64_t stream_idle_frames = 0;	// frames in a row the decoder has sat idle
+vluint64_t stream_busy_end = 0;	// cycle, requests, frames and starved cycles when it last did anything
+vluint64_t stream_busy_requests = 0;
+vluint64_t stream_busy_frames = 0;
+vluint64_t stream_busy_starved = 0;
+
+// A/V sync analyser
+// -----------------
+// Dragon's Lair runs at 23.976 fps (ldp::get_disc_fpks(), and its m2v's sequence header),
+// the rate is taken from the stream once one is open
+#define DISC_FPKS 23976
+#ifndef DISABLE_AUDIO
+SimAVSync avsync(clk_sys_freq, DISC_FPKS, audio.sample_rate);
+bool avsync_vsync = 0;
+uint32_t avsync_seeks = 0;
+double avsync_max_ms = 0;	// --avsync-max, fail a headless run beyond this offset
+#endif
+
+// Scripted events
+// ---------------
+// Per cycle work that isn't clocking the core runs from here, each on its own period
+SimClockEvents events;
+uint8_t polling_finished = 0;
+
 // Reset simulation variables and clocks
 void resetSim() {
 	main_time = 0;
@@ -119,109 +203,192 @@ void resetSim() {
 	top->EXT_BUS = 0;
 	top->EXT_BUS_IN = 0;
 	top->EXT_BUS_OUT = 0;
+#ifdef SIM_CLOCK_DOMAINS
+	clocks.Reset();
+#else
 	clk_sys.Reset();
+#endif
+	events.Reset();
+}
+
+bool releaseReset() {
+	top->reset = 0;
+	return false;
+}
+
+// The values the control window shows, nothing needs them every cycle
+bool sampleStatus() {
+	busy_led = top->led5;
+	error_led = top->led6;
+	stream_dat_count = top->stream_dat_count;
+	EXT_BUS = top->EXT_BUS;
+	return true;
+}
+
+bool startDebugTest() {
+	printf("SIM - debug test - PLAY the video\n");
+	printf("SIM - ext bus out %lu\n", top->EXT_BUS_OUT);
+	top->perform_debug_test = 1;
+	if (!bustrace.replaying && !decoder_only) {
+		daphne_init("lair.txt");
+#ifndef DISABLE_AUDIO
+		// a --stream file replaces what the HPS side sends, its rate already applies
+		if (!stream_file) { avsync.SetFrameRate(daphne_lib_fpks()); }
+#endif
+	}
+	return false;
+}
+
+bool endDebugTest() {
+	top->perform_debug_test = 0;
+//	top->EXT_BUS |= 1UL << 34;
+//	top->EXT_BUS_IN |= 1UL << 34;
+//	top->EXT_BUS_OUT |= 1UL << 34;
+//	printf("SIM - io_enable going high - ext bus in %lu\n", top->EXT_BUS_IN);
+	return false;
+}
+
+/*
+bool sendCdGet() {
+	// CD_GET, needs to be in bits 16-31
+	top->EXT_BUS_IN = 52;
+	top->EXT_BUS_IN = top->EXT_BUS_IN << 16;
+	top->EXT_BUS_IN |= 1UL << 33;
+	top->EXT_BUS_IN |= 1UL << 34;
+	printf("SIM - ext bus - trying to send CD_GET, io_strobe high, io_enable high - %lu\n", top->EXT_BUS_IN);
+	return false;
+}
+*/
+
+bool pollHps() {
+	if (bustrace.replaying || decoder_only) { return false; }
+	// don't poll again from inside a transfer the last poll started
+	if (!spi_bus_busy()) { polling_finished = daphne_poll(); }
+	return !polling_finished;
+}
+
+void addEvents() {
+	events.Add(releaseReset, initialReset, 0);
+	if (!headless_cycles) { events.Add(sampleStatus, 0, 1000); }
+	events.Add(startDebugTest, 600000, 0);
+	events.Add(endDebugTest, 600500, 0);
+	//events.Add(sendCdGet, 612000, 0);
+	events.Add(pollHps, 612501, 1);
+}
+
+// A frame is idle once the stream has run out, busy stayed low the whole frame
+// (the decoder asked for a byte every sys_clk cycle) and the picture didn't change
+void decoderFrame() {
+	stream_frames++;
+	vluint64_t cycles = main_time - stream_frame_start;
+	bool idle = stream_finish && stream_pixels == stream_frame_hash && 2 * (stream.requests - stream_frame_requests) + 2 >= cycles;
+	if (idle) { stream_idle_frames++; }
+	else {
+		stream_idle_frames = 0;
+		stream_busy_end = main_time;
+		stream_busy_requests = stream.requests;
+		stream_busy_frames = stream_frames;
+		stream_busy_starved = stream.starved;
+	}
+	stream_frame_hash = stream_pixels;
+	stream_pixels = 0;
+	stream_frame_start = main_time;
+	stream_frame_requests = stream.requests;
+}
+
+bool decoderDone() {
+	if (!decoder_only || !stream_finish) { return false; }
+	return stream_idle_frames >= STREAM_DRAIN_FRAMES || main_time - stream_finish >= decoder_drain_cycles;
 }
 
 int verilate() {
-    static uint8_t polling_finished = 0;
 	if (!Verilated::gotFinish()) {
 
-		// Assert reset during startup
-		if (main_time < initialReset) { top->reset = 1; }
-		// Deassert reset after startup
-		if (main_time == initialReset) { top->reset = 0; }
-
-		// Clock dividers
+#ifdef SIM_CLOCK_DOMAINS
+		// Straight to the next edge of any domain, the core can't change in between
+		clocks.Advance();
+		top->clk_50 = clk_50.clk;
+		top->clk_25 = clk_vid.clk;
+#else
+		// Every tick of a ratio 1 clock is an edge
 		clk_sys.Tick();
+#endif
 
 		// Set system clock in core
 		top->clk_sys = clk_sys.clk;
 
-		// Simulate both edges of system clock
-		if (clk_sys.clk != clk_sys.old) {
-			if (clk_sys.clk) {
-				//input.BeforeEval();
-				bus.BeforeEval();
-			}
+		// Other edges only need the core evaluated
+		if (!clk_sys.IsRising()) {
 			top->eval();
-			if (clk_sys.clk) { bus.AfterEval(); }
+			return 1;
+		}
+
+		//input.BeforeEval();
+		bus.BeforeEval();
+		bustrace.BeforeEval(main_time, top->EXT_BUS, top->EXT_BUS_IN);
+		if (bustrace.replaying) {
+			top->EXT_BUS = bustrace.bus;
+			top->EXT_BUS_IN = bustrace.bus_in;
 		}
+		top->eval();
+		bus.AfterEval();
+		bustrace.AfterEval(top->EXT_BUS_OUT);
 
 #ifndef DISABLE_AUDIO
-		if (clk_sys.IsRising())
-		{
-			audio.Clock(top->AUDIO_L, top->AUDIO_R);
+		audio.Clock(top->AUDIO_L, top->AUDIO_R);
+		avsync.AudioClock(audio.samples_clocked, main_time);
+
+		// Frames are counted on the falling vsync edge, like SimVideo does
+		if (avsync_vsync && !top->VGA_VS) { avsync.FrameDisplayed(main_time); }
+		avsync_vsync = top->VGA_VS;
+		if (daphne_get_stats()->seeks != avsync_seeks) {
+			avsync_seeks = daphne_get_stats()->seeks;
+			avsync.Search(daphne_get_stats()->seek_frame, main_time);
 		}
 #endif
-		busy_led = top->led5;
-		error_led = top->led6;
-		stream_dat_count = top->stream_dat_count;
-		EXT_BUS = top->EXT_BUS;
+
+		if (decoder_only) {
+			if (!stream_start && stream.requests) { stream_start = main_time; }
+			if (!stream_finish && stream.finished) { stream_finish = main_time; }
+			if (top->CE_PIXEL) { stream_pixels = (stream_pixels ^ (top->VGA_B << 16 | top->VGA_G << 8 | top->VGA_R)) * 0x100000001B3ULL; }
+			if (stream_start && stream_vsync && !top->VGA_VS) { decoderFrame(); }
+			stream_vsync = top->VGA_VS;
+		}
 
 		// Output pixels on rising edge of pixel clock
-		if (clk_sys.IsRising() && top->CE_PIXEL) {
+		if (top->CE_PIXEL && (!headless_cycles || video.hash_frames || video.frame_callback)) {
 			uint32_t colour = 0xFF000000 | top->VGA_B << 16 | top->VGA_G << 8 | top->VGA_R;
 			video.Clock(top->VGA_HB, top->VGA_VB, top->VGA_HS, top->VGA_VS, colour);
 		}
 
-		if (clk_sys.IsRising()) {
-			main_time++;
-            if (main_time == 600000) {
-                printf("SIM - debug test - PLAY the video\n");
-                printf("SIM - ext bus out %lu\n", top->EXT_BUS_OUT);
-                top->perform_debug_test = 1;
-                daphne_init();
-            }
-
-            if (main_time == 600500) {
-                top->perform_debug_test = 0;
-//                top->EXT_BUS |= 1UL << 34;
-//                top->EXT_BUS_IN |= 1UL << 34;
-//                top->EXT_BUS_OUT |= 1UL << 34;
-//                printf("SIM - io_enable going high - ext bus in %lu\n", top->EXT_BUS_IN);
-            }
-
-            /*
-            if (main_time == 612000) {
-                // CD_GET, needs to be in bits 16-31
-                top->EXT_BUS_IN = 52;
-                top->EXT_BUS_IN = top->EXT_BUS_IN << 16;
-                top->EXT_BUS_IN |= 1UL << 33;
-                top->EXT_BUS_IN |= 1UL << 34;
-                printf("SIM - ext bus - trying to send CD_GET, io_strobe high, io_enable high - %lu\n", top->EXT_BUS_IN);
-            }
-            */
-
-            if (main_time > 612500 && polling_finished == 0) {
-                polling_finished = daphne_poll();
-            }
-
-            /*
-            if (top->EXT_BUS_OUT & (1ULL << 32)) {
-                incoming_command_byte_count++;
-
-                if (incoming_command_byte_count == 4) {
-                    printf("SIM - ext bus - command detected - byte 1 - %lu\n", top->EXT_BUS_OUT);
-                }
-                if (incoming_command_byte_count == 5) {
-                    printf("SIM - ext bus - command detected - byte 2 - %lu\n", top->EXT_BUS_OUT);
-                }
-                if (incoming_command_byte_count == 6) {
-                    printf("SIM - ext bus - command detected - byte 3 - %lu\n", top->EXT_BUS_OUT);
-                }
-
-                if (incoming_command_byte_count == 7) {
-                    // All bytes for incoming command have been captured, close off communications
-                    // Disable io_enable and io_strobe
-                    top->EXT_BUS_OUT &= ~(1UL << 34);
-                    top->EXT_BUS_OUT &= ~(1UL << 33);
-                    top->EXT_BUS_IN &= ~(1UL << 34);
-                    top->EXT_BUS_IN &= ~(1UL << 35);
-                    incoming_command_byte_count = 0;
-                }
-            }
-            */
+		main_time++;
+		events.Run(main_time);
+
+		/*
+		if (top->EXT_BUS_OUT & (1ULL << 32)) {
+			incoming_command_byte_count++;
+
+			if (incoming_command_byte_count == 4) {
+				printf("SIM - ext bus - command detected - byte 1 - %lu\n", top->EXT_BUS_OUT);
+			}
+			if (incoming_command_byte_count == 5) {
+				printf("SIM - ext bus - command detected - byte 2 - %lu\n", top->EXT_BUS_OUT);
+			}
+			if (incoming_command_byte_count == 6) {
+				printf("SIM - ext bus - command detected - byte 3 - %lu\n", top->EXT_BUS_OUT);
+			}
+
+			if (incoming_command_byte_count == 7) {
+				// All bytes for incoming command have been captured, close off communications
+				// Disable io_enable and io_strobe
+				top->EXT_BUS_OUT &= ~(1UL << 34);
+				top->EXT_BUS_OUT &= ~(1UL << 33);
+				top->EXT_BUS_IN &= ~(1UL << 34);
+				top->EXT_BUS_IN &= ~(1UL << 35);
+				incoming_command_byte_count = 0;
+			}
 		}
+		*/
 
 		return 1;
 	}
@@ -233,6 +400,112 @@ int verilate() {
 	return 0;
 }
 
+// Advance the core by one clk_sys cycle while Main_MiSTer code is driving the HPS bus
+void hpsBusTick() {
+	vluint64_t t = main_time;
+	while (main_time == t) { verilate(); }
+}
+
+// Headless benchmark: run the core flat out and report how well the HPS side fed the stream
+int runHeadless() {
+	int result = 0;
+	if (frame_hash_log || frame_hash_golden || ref_decode_log) {
+		video.InitialiseHeadless();
+	}
+	if (frame_hash_log || frame_hash_golden) {
+		if (!video.OpenHashLog(frame_hash_log, frame_hash_golden)) { return 1; }
+	}
+	if (ref_decode_log) {
+		if (!refdec.OpenLog(ref_decode_log)) { return 1; }
+		video.frame_callback = refdecFrame;
+	}
+	if (bus_record && !bustrace.Record(bus_record)) { return 1; }
+	if (bus_replay && !bustrace.Replay(bus_replay)) { return 1; }
+
+	auto start = std::chrono::steady_clock::now();
+	while (main_time < headless_cycles && video.hash_mismatch_frame < 0 && !bustrace.finished && !decoderDone()) { verilate(); }
+	double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	const daphne_stream_stats* stats = daphne_get_stats();
+	double sim_seconds = (double)main_time / clk_sys_freq;
+	printf("HEADLESS - %lu cycles, %.4fs simulated in %.2fs wall (%.0f cycles/s)\n", main_time, sim_seconds, wall, main_time / wall);
+	printf("HEADLESS - %u requests, %lu bytes sent, %u short reads, decoder took %d bytes\n", stats->requests, stats->bytes, stats->short_reads, top->stream_dat_count);
+	printf("HEADLESS - %.0f bytes/s of simulated time, %.0f bytes/s wall\n", stats->bytes / sim_seconds, stats->bytes / wall);
+	if (stats->requests) {
+		printf("HEADLESS - request service avg %.1fus, max %.1fus\n", stats->service_ns / 1000.0 / stats->requests, stats->service_ns_max / 1000.0);
+	}
+
+	if (video.hash_frames) {
+		video.CloseHashLog();
+		if (video.hash_mismatch_frame >= 0) {
+			printf("HEADLESS - FAIL: frame %d differs from %s (hash %016llx)\n", video.hash_mismatch_frame, frame_hash_golden, (unsigned long long)video.frame_hash);
+			result = 1;
+		}
+		else if (frame_hash_golden) {
+			printf("HEADLESS - %d frames match %s (%d in reference)\n", video.hash_checked_frames, frame_hash_golden, video.hash_reference_frames);
+		}
+	}
+
+	if (video.frame_callback) {
+		refdec.Report();
+		refdec.CleanUp();
+	}
+
+	if (stream_file) {
+		stream.Report();
+		if (decoder_only && stream_start) {
+			// time the decoder up to the last frame it did anything in, not the idle ones spent waiting for it
+			bool drained = stream_idle_frames >= STREAM_DRAIN_FRAMES;
+			vluint64_t end = drained ? stream_busy_end : main_time;
+			vluint64_t requests = drained ? stream_busy_requests : stream.requests;
+			vluint64_t frames = drained ? stream_busy_frames : stream_frames;
+			vluint64_t starved = drained ? stream_busy_starved : stream.starved;
+			// every sys_clk cycle (clk_sys / 2, see sim.v) from the first request on either took a byte,
+			// was held off by busy, or found nothing to take
+			double seconds = (double)(end - stream_start) / clk_sys_freq;
+			vluint64_t cycles = (end - stream_start) / 2;
+			vluint64_t busy = cycles > requests ? cycles - requests : 0;
+			printf("DECODER - %llu bytes, %llu pictures in %.4fs simulated: %.0f bytes/s, %.2f pictures/s, %.2f frames/s displayed\n",
+				(unsigned long long)stream.bytes_served, (unsigned long long)stream.pictures, seconds, stream.bytes_served / seconds,
+				stream.pictures / seconds, frames / seconds);
+			printf("DECODER - input stalled %llu cycles (%.1f%%) by busy, starved %llu cycles\n", (unsigned long long)busy,
+				100.0 * busy / cycles, (unsigned long long)starved);
+			if (drained) {
+				printf("DECODER - drained %llu cycles after the stream ended\n", (unsigned long long)(stream_busy_end - stream_finish));
+			}
+			else if (stream_finish) {
+				printf("DECODER - not drained %llu cycles after the stream ended\n", (unsigned long long)(main_time - stream_finish));
+			}
+			else {
+				printf("DECODER - stream not finished\n");
+			}
+		}
+		stream.CleanUp();
+	}
+
+	if (bus_record || bus_replay) {
+		bustrace.CleanUp();
+		bustrace.Report();
+		if (bustrace.mismatches) {
+			printf("HEADLESS - FAIL: EXT_BUS_OUT differs from %s\n", bus_replay);
+			result = 1;
+		}
+	}
+
+#ifndef DISABLE_AUDIO
+	avsync.Report();
+	avsync.CleanUp();
+	if (avsync_max_ms > 0 && fabs(avsync.worst_offset_ms) > avsync_max_ms) {
+		printf("HEADLESS - FAIL: A/V offset reached %.2fms, limit %.2fms\n", avsync.worst_offset_ms, avsync_max_ms);
+		result = 1;
+	}
+#endif
+
+	top->final();
+	delete top;
+	return result;
+}
+
 unsigned char mouse_clock = 0;
 unsigned char mouse_clock_reduce = 0;
 unsigned char mouse_buttons = 0;
@@ -263,6 +536,63 @@ int main(int argc, char** argv, char** env) {
 	//bus.ioctl_din = &top->ioctl_din;
 	//input.ps2_key = &top->ps2_key;
 
+#ifdef SIM_CLOCK_DOMAINS
+	clocks.Add(&clk_sys);
+	clocks.Add(&clk_50);
+	clocks.Add(&clk_vid);
+#endif
+
+	// Main_MiSTer transfers run the core cycle by cycle, 8-bit file I/O like the real core
+	spi_bus_init(hpsBusTick, 0);
+
+	// --headless [cycles] skips the UI entirely
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--headless")) {
+			headless_cycles = (i + 1 < argc) ? strtoull(argv[i + 1], NULL, 10) : 0;
+			if (!headless_cycles) { headless_cycles = 2000000; }
+		}
+		// --frame-hash-log <file> records a hash per frame, --golden <file> compares against a previous log
+		if (!strcmp(argv[i], "--frame-hash-log") && i + 1 < argc) { frame_hash_log = argv[i + 1]; }
+		if (!strcmp(argv[i], "--golden") && i + 1 < argc) { frame_hash_golden = argv[i + 1]; }
+		// --ref-decode <csv> logs PSNR per frame against libmpeg2, --ref-maps <prefix> writes mismatch maps,
+		// --ref-origin <x> <y> is where the picture sits in the VGA buffer
+		if (!strcmp(argv[i], "--ref-decode") && i + 1 < argc) { ref_decode_log = argv[i + 1]; }
+		if (!strcmp(argv[i], "--ref-maps") && i + 1 < argc) { refdec.map_prefix = argv[i + 1]; }
+		if (!strcmp(argv[i], "--ref-origin") && i + 2 < argc) {
+			refdec.origin_x = atoi(argv[i + 1]);
+			refdec.origin_y = atoi(argv[i + 2]);
+		}
+#ifndef DISABLE_AUDIO
+		// --avsync-log <csv> writes every frame's offset, --avsync-max <ms> sets the headless failure limit
+		if (!strcmp(argv[i], "--avsync-log") && i + 1 < argc) { avsync.OpenLog(argv[i + 1]); }
+		if (!strcmp(argv[i], "--avsync-max") && i + 1 < argc) { avsync_max_ms = atof(argv[i + 1]); }
+#endif
+		// --bus-record <file> captures EXT_BUS traffic, --bus-replay <file> drives it back without daphne.cpp,
+		// --bus-decode <file> lists a capture's transactions and exits
+		if (!strcmp(argv[i], "--bus-record") && i + 1 < argc) { bus_record = argv[i + 1]; }
+		if (!strcmp(argv[i], "--bus-replay") && i + 1 < argc) { bus_replay = argv[i + 1]; }
+		if (!strcmp(argv[i], "--bus-decode") && i + 1 < argc) { return bustrace.Decode(argv[i + 1], stdout) ? 0 : 1; }
+		// --stream <file.m2v> maps the file and feeds it to the decoder through the DPI, --stream-loop repeats it
+		if (!strcmp(argv[i], "--stream") && i + 1 < argc) { stream_file = argv[i + 1]; }
+		if (!strcmp(argv[i], "--stream-loop")) { stream.loop = true; }
+		// --decoder-only skips daphne_init/daphne_poll and reports the decoder's own throughput on --stream
+		if (!strcmp(argv[i], "--decoder-only")) { decoder_only = 1; }
+		// --drain-cycles <n> caps the wait for the decoder to finish once the stream has run out (default one simulated second)
+		if (!strcmp(argv[i], "--drain-cycles") && i + 1 < argc) { decoder_drain_cycles = strtoull(argv[i + 1], NULL, 10); }
+	}
+	if (!decoder_drain_cycles) { decoder_drain_cycles = clk_sys_freq; }
+	top->reset = 1;
+	addEvents();
+	if (stream_file && !stream.Open(stream_file)) { return 1; }
+#ifndef DISABLE_AUDIO
+	avsync.SetFrameRate(stream.fpks);
+#endif
+	if (decoder_only && (!stream_file || !headless_cycles)) {
+		printf("SIM - --decoder-only needs --stream and --headless\n");
+		return 1;
+	}
+	if (headless_cycles) { return runHeadless(); }
+
 #ifndef DISABLE_AUDIO
 	audio.Initialise();
 #endif
@@ -430,7 +760,7 @@ if (ImGui::Button("Load Tape"))
 		ImGui::SliderFloat("Zoom", &vga_scale, 1, 8); ImGui::SameLine();
 		ImGui::SliderInt("Rotate", &video.output_rotate, -1, 1); ImGui::SameLine();
 		ImGui::Checkbox("Flip V", &video.output_vflip);
-		ImGui::Text("main_time: %d frame_count: %d sim FPS: %f Stream.dat: %d", main_time, video.count_frame, video.stats_fps, stream_dat_count);
+		ImGui::Text("main_time: %d frame_count: %d sim FPS: %f Stream: %d", main_time, video.count_frame, video.stats_fps, stream_dat_count);
 		ImGui::Text("EXT_BUS: %lu", EXT_BUS);
 
 		// Draw VGA output
@@ -471,6 +801,16 @@ fprintf(stderr,"filePath: %s\n",filePath.c_str());
 		if (run_enable) {
 			audio.CollectDebug((signed short)top->AUDIO_L, (signed short)top->AUDIO_R);
 		}
+		audio.UpdateOutput(run_enable);
+		ImGui::Checkbox("Play", &audio.playback); ImGui::SameLine();
+		if (audio.output_rate) {
+			ImGui::Text("Sim rate: %.0f Hz  Device: %d Hz  Buffered: %d", audio.input_rate, audio.output_rate, audio.buffered);
+			ImGui::Text("Underruns: %u  Overruns: %u", audio.underruns, audio.overruns);
+		}
+		else {
+			ImGui::Text("No audio device");
+		}
+		ImGui::Text("A/V offset: %.2fms  Worst: %.2fms  Resync: %.2fms  Drift: %.3fms/s", avsync.offset_ms, avsync.worst_offset_ms, avsync.worst_resync_ms, avsync.drift_ms_per_s);
 		int channelWidth = (windowWidth / 2)  -16;
 		//ImPlot::CreateContext();
 		//if (ImPlot::BeginPlot("Audio - L", ImVec2(channelWidth, 220), ImPlotFlags_NoLegend | ImPlotFlags_NoMenus | ImPlotFlags_NoTitle)) {
@@ -553,6 +893,7 @@ fprintf(stderr,"filePath: %s\n",filePath.c_str());
 
 #ifndef DISABLE_AUDIO
 	audio.CleanUp();
+	avsync.CleanUp();
 #endif 
 	video.CleanUp();
 	input.CleanUp();